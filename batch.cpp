@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <thread>
+
+#include "batch.h"
+
+BatchAligner::BatchAligner(const SequenceStore& store_, const ViewPairList& list_, const BloSum62<int>& blosum62_, size_t threads_, size_t buffer_, eMemory memory_, const Region& region_) :
+	m_Store_(store_), m_List_(list_), m_BloSum62_(blosum62_),
+	m_Threads_(std::max<size_t>(threads_, 1)), m_Chunk_(std::max<size_t>(buffer_/2, 1)), m_Memory_(memory_), m_Region_(region_),
+	m_Wavefront_(m_Threads_, [this]() { std::lock_guard<std::mutex> guard(m_Mutex_); m_TaskReady_.notify_all(); }),
+	m_Queues_(m_Threads_), m_Queued_(0),
+	m_Released_(0), m_Finished_(0), m_Slots_(2*m_Chunk_), m_Ready_(2*m_Chunk_, false)
+{}
+
+void BatchAligner::Run(const BatchOutput& output_)
+{
+	std::vector<std::thread> workers;
+	std::unique_lock<std::mutex> lock(m_Mutex_);
+
+	// two chunks in flight: one finishing while the next one starts.
+	Release();
+	Release();
+	for(size_t w = 0; w < m_Threads_; ++w)
+		workers.push_back(std::thread(&BatchAligner::Work, this, w));
+
+	for(size_t next = 0; next < m_List_.size(); ++next)
+	{
+		// wait for the next pair in input order.
+		size_t slot = next % m_Slots_.size();
+		m_ResultReady_.wait(lock, [this, slot]() { return (bool)m_Ready_[slot]; });
+		BatchResult result = std::move(m_Slots_[slot]);
+		m_Ready_[slot] = false;
+
+		// the chunk before the current one is out, its slots can take a new chunk.
+		if((next + 1) % m_Chunk_ == 0)
+			Release();
+
+		lock.unlock();
+		output_(m_Store_.Get(m_List_[next].first), m_Store_.Get(m_List_[next].second), result);
+		lock.lock();
+	}
+
+	lock.unlock();
+	for(std::thread& worker : workers)
+		worker.join();
+}
+
+void BatchAligner::Release()
+{
+	// caller holds m_Mutex_.
+	size_t begin = m_Released_, end = std::min(m_Released_ + m_Chunk_, m_List_.size());
+	if(begin >= end)
+		return;
+
+	// longest first, so the big pairs do not start last and hold up the tail.
+	std::vector<size_t> order;
+	for(size_t k = begin; k < end; ++k)
+		order.push_back(k);
+	auto cells = [this](size_t k_) { return m_Store_.Get(m_List_[k_].first).length*m_Store_.Get(m_List_[k_].second).length; };
+	std::stable_sort(order.begin(), order.end(), [&cells](size_t a_, size_t b_) { return cells(a_) > cells(b_); });
+
+	// deal the chunk round robin, every queue gets a share of the long pairs.
+	for(size_t k = 0; k < order.size(); ++k)
+	{
+		TaskQueue& queue = m_Queues_[k % m_Threads_];
+		std::lock_guard<std::mutex> guard(queue.mutex);
+		queue.tasks.push_back(order[k]);
+	}
+
+	m_Released_ = end;
+	m_Queued_ += order.size();
+	m_TaskReady_.notify_all();
+}
+
+bool BatchAligner::PopTask(size_t worker_, size_t& index_)
+{
+	// the own queue from the front (longest first).
+	{
+		TaskQueue& queue = m_Queues_[worker_];
+		std::lock_guard<std::mutex> guard(queue.mutex);
+		if(!queue.tasks.empty())
+		{
+			index_ = queue.tasks.front();
+			queue.tasks.pop_front();
+			--m_Queued_;
+			return true;
+		}
+	}
+	// steal from the back of the others.
+	for(size_t k = 1; k < m_Threads_; ++k)
+	{
+		TaskQueue& queue = m_Queues_[(worker_ + k) % m_Threads_];
+		std::lock_guard<std::mutex> guard(queue.mutex);
+		if(!queue.tasks.empty())
+		{
+			index_ = queue.tasks.back();
+			queue.tasks.pop_back();
+			--m_Queued_;
+			return true;
+		}
+	}
+	return false;
+}
+
+void BatchAligner::Work(size_t worker_)
+{
+	// one matrix per thread, shared by all its solvers, and the buffers they reuse from one pair to the next.
+	BloSum62<int> bloSum62(m_BloSum62_);
+	Workspace<int> workspace;
+	Sequence seq1, seq2;
+	std::string residues;
+
+	while(true)
+	{
+		// no pair of its own: the tiles of a pair on another thread, or wait for the next chunk or grid.
+		// the lock order is m_Mutex_, then the one of the wavefront.
+		size_t index = 0;
+		if(!PopTask(worker_, index))
+		{
+			if(m_Wavefront_.Help())
+				continue;
+			std::unique_lock<std::mutex> lock(m_Mutex_);
+			m_TaskReady_.wait(lock, [this]() { return m_Queued_ > 0 || m_Finished_ == m_List_.size() || m_Wavefront_.IsRunning(); });
+			if(m_Finished_ == m_List_.size())
+				return;		// every pair is aligned, no grid is left to help with.
+			continue;
+		}
+
+		// the residues only, the names are taken from the store on output.
+		BatchResult result;
+		Stopwatch watch;
+		m_Store_.Decode(m_List_[index].first, residues);
+		seq1.SetSequence(residues);
+		m_Store_.Decode(m_List_[index].second, residues);
+		seq2.SetSequence(residues);
+		result.decodeTime = watch.Lap();
+
+		Solver<int> solver(seq1, seq2, bloSum62, m_Memory_, nullptr, m_Region_, &m_Wavefront_, &workspace);
+		result.score = solver.Update();
+		result.fillTime = watch.Lap();
+		solver.Construct(result.alignment);
+		result.traceTime = watch.Lap();
+		result.limited = solver.IsLimited();
+		result.linear = solver.IsLinear();
+		result.cells = solver.GetCells();
+
+		// the slot is free: a pair is only released once the pair two chunks before it is out.
+		std::lock_guard<std::mutex> guard(m_Mutex_);
+		size_t slot = index % m_Slots_.size();
+		m_Slots_[slot] = std::move(result);
+		m_Ready_[slot] = true;
+		m_ResultReady_.notify_one();
+		if(++m_Finished_ == m_List_.size())
+			m_TaskReady_.notify_all();
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+
+#include "common.h"
+#include "blosum62.hxx"
+#include "solver.hxx"
+#include "loader.h"
+#include "wavefront.h"
+#include "instrument.h"
+
+// the alignment of one pair of the list.
+struct BatchResult
+{
+	int score;
+	SeqPair alignment;
+	bool limited;		// see Solver<T>::IsLimited()
+	bool linear;		// see Solver<T>::IsLinear()
+	size_t cells;		// see Solver<T>::GetCells()
+	// seconds: the residues out of the store, Solver<T>::Update() and Solver<T>::Construct().
+	double decodeTime, fillTime, traceTime;
+};
+
+typedef std::function<void(const SequenceView&, const SequenceView&, const BatchResult&)> BatchOutput;
+
+// aligns pairs of sequences of a SequenceStore on several threads.
+// the pairs are released a chunk at a time, longest first inside the chunk, and dealt to one queue per thread;
+// a thread with an empty queue steals from the back of the others.
+// a pair above Solver<int>::s_WavefrontCells_ cells is split into tiles, and the threads without a pair take its tiles, so a huge pair at the end
+// of the list does not run alone. the tiles run on the same threads as the pairs, no more threads than threads_ are busy at a time.
+// a pair is decoded only while it is aligned. results reach the output in input order through a reorder buffer of two chunks, so memory does not grow with the list.
+class BatchAligner
+{
+public:
+	BatchAligner(const SequenceStore& store_, const ViewPairList& list_, const BloSum62<int>& blosum62_, size_t threads_, size_t buffer_, eMemory memory_, const Region& region_ = Region());
+
+	// align every pair, output_ is called on the calling thread in input order.
+	void Run(const BatchOutput& output_);
+
+private:
+	// a queue of pair indices owned by one thread.
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::deque<size_t> tasks;
+	};
+
+	void Release();
+	bool PopTask(size_t worker_, size_t& index_);
+	void Work(size_t worker_);
+
+private:
+	const SequenceStore& m_Store_;
+	const ViewPairList& m_List_;
+	const BloSum62<int>& m_BloSum62_;
+	size_t m_Threads_, m_Chunk_;
+	eMemory m_Memory_;
+	Region m_Region_;
+	Wavefront m_Wavefront_;
+
+	std::vector<TaskQueue> m_Queues_;
+	std::atomic<size_t> m_Queued_;
+
+	// guarded by m_Mutex_.
+	std::mutex m_Mutex_;
+	std::condition_variable m_TaskReady_, m_ResultReady_;
+	size_t m_Released_, m_Finished_;
+	std::vector<BatchResult> m_Slots_;
+	std::vector<bool> m_Ready_;
+};
+
+#endif	// __BATCH_H__
@@ -0,0 +1,384 @@
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <random>
+
+#include "common.h"
+#include "utils.h"
+#include "loader.h"
+#include "solver.hxx"
+#include "blosum62.hxx"
+#include "striped.h"
+#include "instrument.h"
+
+#ifndef BENCH_DATA_DIR
+#define BENCH_DATA_DIR "."
+#endif
+
+using namespace std;
+
+// every allocation of the process goes through here, so each stage can tell how many it made and how much
+// heap it held at most. a block starts with its size, so the unsized deletes can take it off the live bytes.
+static std::atomic<size_t> s_Allocations(0);
+static std::atomic<size_t> s_AllocatedBytes(0);
+static std::atomic<size_t> s_LiveBytes(0);
+static std::atomic<size_t> s_PeakBytes(0);
+static const size_t s_Header = 16;		// keeps the alignment of malloc
+
+void* operator new(size_t size_)
+{
+	++s_Allocations;
+	s_AllocatedBytes += size_;
+	unsigned char* memory = (unsigned char*)malloc(size_ + s_Header);
+	if(memory == nullptr)
+		throw std::bad_alloc();
+	*(size_t*)memory = size_;
+
+	const size_t live = (s_LiveBytes += size_);
+	size_t peak = s_PeakBytes;
+	while(live > peak && !s_PeakBytes.compare_exchange_weak(peak, live))
+		;
+	return memory + s_Header;
+}
+void* operator new[](size_t size_)
+{
+	return operator new(size_);
+}
+static void Release(void* memory_)
+{
+	if(memory_ == nullptr)
+		return;
+	unsigned char* memory = (unsigned char*)memory_ - s_Header;
+	s_LiveBytes -= *(size_t*)memory;
+	free(memory);
+}
+void operator delete(void* memory_) noexcept
+{
+	Release(memory_);
+}
+void operator delete[](void* memory_) noexcept
+{
+	Release(memory_);
+}
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* memory_, size_t) noexcept
+{
+	Release(memory_);
+}
+void operator delete[](void* memory_, size_t) noexcept
+{
+	Release(memory_);
+}
+#endif
+
+// the allocations, the heap high-water mark and the wall time of one measurement.
+// one probe at a time: a probe restarts the high-water mark.
+class Probe
+{
+public:
+	Probe() :
+		m_Allocations_(s_Allocations), m_Bytes_(s_AllocatedBytes), m_Live_(s_LiveBytes)
+	{
+		s_PeakBytes = m_Live_;
+	}
+
+	inline double GetSeconds() const
+	{
+		return m_Watch_.GetSeconds();
+	}
+	inline size_t GetAllocations() const
+	{
+		return s_Allocations - m_Allocations_;
+	}
+	inline size_t GetBytes() const
+	{
+		return s_AllocatedBytes - m_Bytes_;
+	}
+	// the most heap held since the probe started, above what was live then.
+	inline size_t GetPeakBytes() const
+	{
+		const size_t peak = s_PeakBytes;
+		return (peak > m_Live_) ? peak - m_Live_ : 0;
+	}
+
+private:
+	size_t m_Allocations_, m_Bytes_, m_Live_;
+	Stopwatch m_Watch_;
+};
+
+// a pair of residue strings to align.
+typedef std::vector<SeqPair> PairList;
+
+// the fill and traceback of a list of pairs in one mode.
+struct SolverRun
+{
+	double cells;
+	double fill, traceback;		// seconds
+	size_t allocations;			// per pass over the list
+	size_t peakBytes;			// the most heap the run held: workspace, traces and alignments
+	long long checksum;			// the sum of the scores, the same in every mode
+};
+
+typedef enum
+{
+	RunFull,		// MemoryFull, one workspace for all pairs
+	RunFresh,		// MemoryFull, a new workspace per pair
+	RunLinear,		// MemoryLinear, one workspace
+	RunScore		// Score() only, no traceback
+} eRun;
+
+static const char* RunName(eRun run_)
+{
+	switch(run_)
+	{
+	case eRun::RunFull:		return "full";
+	case eRun::RunFresh:	return "full, fresh";
+	case eRun::RunLinear:	return "linear";
+	default:				return "score only";
+	}
+}
+
+// repeat_ passes over pairs_, after one pass to size the workspace. the times are per pass.
+static SolverRun RunSolver(const PairList& pairs_, const BloSum62<int>& blosum62_, eRun run_, size_t repeat_)
+{
+	SolverRun result = SolverRun();
+	for(const SeqPair& pair : pairs_)
+		result.cells += (double)(pair.first.length() + 1)*(double)(pair.second.length() + 1);
+
+	Probe run;
+	Workspace<int> workspace;
+	Sequence seq1, seq2;
+	SeqPair alignment;
+	const eMemory memory = (run_ == eRun::RunLinear || run_ == eRun::RunScore) ? eMemory::MemoryLinear : eMemory::MemoryFull;
+	for(size_t pass = 0; pass <= repeat_; ++pass)
+	{
+		const size_t allocations = s_Allocations;
+		double fill = 0.0, traceback = 0.0;
+		long long checksum = 0;
+		for(const SeqPair& pair : pairs_)
+		{
+			Stopwatch watch;
+			seq1.SetSequence(pair.first);
+			seq2.SetSequence(pair.second);
+			Solver<int> solver(seq1, seq2, blosum62_, memory, nullptr, Region(), nullptr, (run_ == eRun::RunFresh) ? nullptr : &workspace);
+			if(run_ == eRun::RunScore)
+			{
+				checksum += solver.Score();
+				fill += watch.Lap();
+				continue;
+			}
+			checksum += solver.Update();
+			fill += watch.Lap();
+			solver.Construct(alignment);
+			traceback += watch.Lap();
+		}
+		// pass 0 sizes the buffers.
+		if(pass == 0)
+			continue;
+		result.fill += fill/repeat_;
+		result.traceback += traceback/repeat_;
+		result.allocations = s_Allocations - allocations;
+		result.checksum = checksum;
+	}
+	result.peakBytes = run.GetPeakBytes();
+	return result;
+}
+
+static void PrintRun(const std::string& name_, size_t pairs_, eRun run_, const SolverRun& run)
+{
+	cout << left << setw(24) << name_ << setw(12) << RunName(run_) << right
+		<< setw(8) << pairs_ << setw(14) << (size_t)run.cells
+		<< setw(10) << fixed << setprecision(4) << run.fill << setw(10) << run.traceback
+		<< setw(8) << setprecision(3) << GetGcups(run.cells, run.fill)
+		<< setw(10) << run.allocations << setw(10) << run.peakBytes/1024
+		<< setw(16) << run.checksum << endl;
+}
+
+static void PrintSolverHeader()
+{
+	cout << left << setw(24) << "data" << setw(12) << "mode" << right
+		<< setw(8) << "pairs" << setw(14) << "cells" << setw(10) << "fill s" << setw(10) << "trace s"
+		<< setw(8) << "gcups" << setw(10) << "allocs" << setw(10) << "heap KB" << setw(16) << "checksum" << endl;
+}
+
+// count_ pairs of length_ residues, the second one a copy of the first with 1 - identity_ of its residues substituted.
+static void Synthesize(size_t count_, size_t length_, double identity_, std::mt19937& random_, PairList& pairs_)
+{
+	std::uniform_int_distribution<size_t> residue(0, g_ResidueCount - 1), other(1, g_ResidueCount - 1);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	pairs_.clear();
+	for(size_t p = 0; p < count_; ++p)
+	{
+		std::string seq1(length_, ' '), seq2(length_, ' ');
+		for(size_t k = 0; k < length_; ++k)
+		{
+			const size_t code = residue(random_);
+			seq1[k] = g_Residues[code];
+			seq2[k] = (chance(random_) < identity_) ? seq1[k] : g_Residues[(code + other(random_)) % g_ResidueCount];
+		}
+		pairs_.push_back(SeqPair(seq1, seq2));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string data = BENCH_DATA_DIR;
+	size_t repeat = 3;
+	bool quick = false;
+	for(int k = 1; k < argc; ++k)
+	{
+		std::string option = std::string(argv[k]);
+		if(option == "--data" && k + 1 < argc)
+			data = std::string(argv[++k]);
+		else if(option == "--repeat" && k + 1 < argc)
+			repeat = std::max<size_t>(std::stoull(argv[++k]), 1);
+		else if(option == "--quick")
+			quick = true;
+		else
+		{
+			cout << "usage: benchmark [options]" << endl;
+			cout << "--data DIR	---	the directory of seqfile.txt and seqfile2.txt (default " << BENCH_DATA_DIR << ")" << endl;
+			cout << "--repeat N	---	measured passes per case, after one warm-up pass (default 3)" << endl;
+			cout << "--quick	---	short synthetic sequences only, for a smoke test" << endl;
+			return -1;
+		}
+	}
+	const std::string files[] = { data + "/seqfile.txt", data + "/seqfile2.txt" };
+	cout << "vector unit: " << StripedIsa() << ", repeat: " << repeat << endl << endl;
+
+	//--------------------------------------------------//
+	// loader: parse into a SequenceStore.				//
+	//--------------------------------------------------//
+
+	cout << left << setw(24) << "loader" << right << setw(10) << "seqs" << setw(12) << "residues" << setw(10) << "parse s"
+		<< setw(10) << "pairs s" << setw(10) << "allocs" << setw(12) << "legacy s" << setw(10) << "allocs" << endl;
+	std::vector<PairList> filePairs;
+	for(const std::string& file : files)
+	{
+		SequenceStore store;
+		if(!store.Open(file))
+		{
+			cout << "can not open " << file << endl;
+			return -2;
+		}
+		size_t residues = 0;
+		for(size_t k = 0; k < store.Size(); ++k)
+			residues += store.Get(k).length;
+
+		double parse = 0.0, pairs = 0.0, legacy = 0.0;
+		size_t allocations = 0, legacyAllocations = 0;
+		ViewPairList list;
+		for(size_t pass = 0; pass < repeat; ++pass)
+		{
+			// GetPairs() appends, every pass starts from an empty list.
+			list.clear();
+			Probe probe;
+			Stopwatch watch;
+			store.Open(file);
+			parse += watch.Lap();
+			store.GetPairs(ePairing::PairFirst, list);
+			pairs += watch.Lap();
+			allocations = probe.GetAllocations();
+
+			// the loader before the SequenceStore, for comparison.
+			Probe legacyProbe;
+			ComparePairList compare;
+			GetProteinSequencePairs(file, compare);
+			legacy += legacyProbe.GetSeconds();
+			legacyAllocations = legacyProbe.GetAllocations();
+		}
+		cout << left << setw(24) << file.substr(file.find_last_of("/\\") + 1) << right << setw(10) << store.Size() << setw(12) << residues
+			<< setw(10) << fixed << setprecision(5) << parse/repeat << setw(10) << pairs/repeat << setw(10) << allocations
+			<< setw(12) << legacy/repeat << setw(10) << legacyAllocations << endl;
+
+		PairList pairList;
+		for(const ViewPair& pair : list)
+			pairList.push_back(SeqPair(store.Decode(pair.first), store.Decode(pair.second)));
+		filePairs.push_back(pairList);
+	}
+	cout << endl;
+
+	//--------------------------------------------------//
+	// BloSum62: the score lookups of the kernels.		//
+	//--------------------------------------------------//
+
+	{
+		// the access pattern of the kernels: one seq1 residue per row, the query walked from left to right.
+		// a query of 1024 residues keeps the profile (21 rows) in the cache, as it is for a real pair.
+		BloSum62<int> bloSum62;
+		std::mt19937 random(7);
+		const size_t lookups = quick ? (1 << 20) : (1 << 24);
+		const size_t queryLength = 1024, rows = lookups/queryLength;
+		std::vector<unsigned char> query(queryLength), seq1(rows);
+		std::string queryLetters(queryLength, ' '), seq1Letters(rows, ' ');
+		for(size_t j = 0; j < queryLength; ++j)
+		{
+			query[j] = (unsigned char)(random() % g_ResidueCount);
+			queryLetters[j] = g_Residues[query[j]];
+		}
+		for(size_t i = 0; i < rows; ++i)
+		{
+			seq1[i] = (unsigned char)(random() % g_ResidueCount);
+			seq1Letters[i] = g_Residues[seq1[i]];
+		}
+
+		long long sum = 0;
+		Stopwatch watch;
+		for(size_t i = 0; i < rows; ++i)
+			for(size_t j = 0; j < queryLength; ++j)
+				sum += bloSum62.GetScore(seq1[i], query[j]);
+		const double byCode = watch.Lap();
+		for(size_t i = 0; i < rows; ++i)
+			for(size_t j = 0; j < queryLength; ++j)
+				sum += bloSum62.GetValue(seq1Letters[i], queryLetters[j]);
+		const double byLetter = watch.Lap();
+		QueryProfile<int> profile(bloSum62, query.data(), queryLength);
+		for(size_t i = 0; i < rows; ++i)
+		{
+			const int* row = profile.GetRow(seq1[i]);
+			for(size_t j = 0; j < queryLength; ++j)
+				sum += row[j];
+		}
+		const double byProfile = watch.Lap();
+
+		cout << "BloSum62 lookups: " << rows*queryLength << ", ns per lookup: code " << setprecision(3) << byCode/(rows*queryLength)*1e9
+			<< ", letter " << byLetter/(rows*queryLength)*1e9 << ", profile " << byProfile/(rows*queryLength)*1e9 << " (checksum " << sum << ")" << endl << endl;
+	}
+
+	//--------------------------------------------------//
+	// Solver<int>: fill and traceback.					//
+	//--------------------------------------------------//
+
+	BloSum62<int> bloSum62;
+	const eRun runs[] = { eRun::RunFull, eRun::RunFresh, eRun::RunLinear, eRun::RunScore };
+	PrintSolverHeader();
+	if(!quick)
+	{
+		for(size_t f = 0; f < filePairs.size(); ++f)
+		{
+			const std::string name = files[f].substr(files[f].find_last_of("/\\") + 1);
+			for(eRun run : runs)
+				PrintRun(name, filePairs[f].size(), run, RunSolver(filePairs[f], bloSum62, run, repeat));
+		}
+	}
+
+	// synthetic pairs of one length and identity, about the same cells for each length.
+	std::mt19937 random(11);
+	const std::vector<size_t> lengths = quick ? std::vector<size_t>{ 50, 200 } : std::vector<size_t>{ 100, 500, 2000, 5000 };
+	const double cellBudget = quick ? 1e6 : 5e7;
+	for(size_t length : lengths)
+	{
+		for(double identity : { 0.9, 0.5 })
+		{
+			PairList pairs;
+			Synthesize(std::max<size_t>((size_t)(cellBudget/((double)length*length)), 1), length, identity, random, pairs);
+			std::ostringstream name;
+			name << "synthetic " << length << " " << (int)(identity*100) << "%";
+			for(eRun run : runs)
+				PrintRun(name.str(), pairs.size(), run, RunSolver(pairs, bloSum62, run, repeat));
+		}
+	}
+
+	return 0;
+}
@@ -1,18 +1,55 @@
 #ifndef __BLOSUM62_HXX__
 #define __BLOSUM62_HXX__
 
+#include <algorithm>
+
 #include "common.h"
 
+// BLOSUM62 in the order of g_Residues, the last row and column are 'X' (NCBI values).
+constexpr int g_BuiltinBloSum62[g_ResidueCount + 1][g_ResidueCount + 1] =
+{
+	{ 4, -1, -2, -2,  0, -1, -1,  0, -2, -1, -1, -1, -1, -2, -1,  1,  0, -3, -2,  0,  0},	// A
+	{-1,  5,  0, -2, -3,  1,  0, -2,  0, -3, -2,  2, -1, -3, -2, -1, -1, -3, -2, -3, -1},	// R
+	{-2,  0,  6,  1, -3,  0,  0,  0,  1, -3, -3,  0, -2, -3, -2,  1,  0, -4, -2, -3, -1},	// N
+	{-2, -2,  1,  6, -3,  0,  2, -1, -1, -3, -4, -1, -3, -3, -1,  0, -1, -4, -3, -3, -1},	// D
+	{ 0, -3, -3, -3,  9, -3, -4, -3, -3, -1, -1, -3, -1, -2, -3, -1, -1, -2, -2, -1, -2},	// C
+	{-1,  1,  0,  0, -3,  5,  2, -2,  0, -3, -2,  1,  0, -3, -1,  0, -1, -2, -1, -2, -1},	// Q
+	{-1,  0,  0,  2, -4,  2,  5, -2,  0, -3, -3,  1, -2, -3, -1,  0, -1, -3, -2, -2, -1},	// E
+	{ 0, -2,  0, -1, -3, -2, -2,  6, -2, -4, -4, -2, -3, -3, -2,  0, -2, -2, -3, -3, -1},	// G
+	{-2,  0,  1, -1, -3,  0,  0, -2,  8, -3, -3, -1, -2, -1, -2, -1, -2, -2,  2, -3, -1},	// H
+	{-1, -3, -3, -3, -1, -3, -3, -4, -3,  4,  2, -3,  1,  0, -3, -2, -1, -3, -1,  3, -1},	// I
+	{-1, -2, -3, -4, -1, -2, -3, -4, -3,  2,  4, -2,  2,  0, -3, -2, -1, -2, -1,  1, -1},	// L
+	{-1,  2,  0, -1, -3,  1,  1, -2, -1, -3, -2,  5, -1, -3, -1,  0, -1, -3, -2, -2, -1},	// K
+	{-1, -1, -2, -3, -1,  0, -2, -3, -2,  1,  2, -1,  5,  0, -2, -1, -1, -1, -1,  1, -1},	// M
+	{-2, -3, -3, -3, -2, -3, -3, -3, -1,  0,  0, -3,  0,  6, -4, -2, -2,  1,  3, -1, -1},	// F
+	{-1, -2, -2, -1, -3, -1, -1, -2, -2, -3, -3, -1, -2, -4,  7, -1, -1, -4, -3, -2, -2},	// P
+	{ 1, -1,  1,  0, -1,  0,  0,  0, -1, -2, -2,  0, -1, -2, -1,  4,  1, -3, -2, -2,  0},	// S
+	{ 0, -1,  0, -1, -1, -1, -1, -2, -2, -1, -1, -1, -1, -2, -1,  1,  5, -2, -2,  0,  0},	// T
+	{-3, -3, -4, -4, -2, -2, -3, -2, -2, -3, -2, -3, -1,  1, -4, -3, -2, 11,  2, -3, -2},	// W
+	{-2, -2, -2, -3, -2, -1, -2, -3,  2, -1, -1, -2, -1,  3, -3, -2, -2,  2,  7, -1, -1},	// Y
+	{ 0, -3, -3, -3, -1, -2, -2, -3, -3,  3,  1, -2,  1, -1, -2, -2,  0, -3, -1,  4, -1},	// V
+	{ 0, -1, -1, -1, -2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -2,  0,  0, -2, -1, -1, -1}	// X
+};
+
+// a substitution matrix over g_Residues plus the unknown residue 'X', indexed by residue code.
+// the name stays, any matrix in the same format can be loaded (BLOSUM45/80, PAM250, ...).
 template <typename T>
 class BloSum62
 {
 public:
+	// the built-in BLOSUM62.
 	BloSum62() :
-		m_Matrix_(nullptr), m_Proteins_("")
-	{}
+		m_Loaded_(true)
+	{
+		for(size_t i = 0; i < s_Alphabet_; ++i)
+		{
+			for(size_t j = 0; j < s_Alphabet_; ++j)
+				m_Matrix_[i*s_Alphabet_ + j] = (T)g_BuiltinBloSum62[i][j];
+		}
+	}
 
 	BloSum62(const std::string& blofile) :
-		m_Proteins_("")
+		m_Loaded_(false)
 	{
 		// blofile format:
 		//		A	R	N	D	C	Q	E	G	H	I	L	K	M	F	P	S	T	W	Y	V
@@ -36,158 +73,208 @@ public:
 		//	W	-3																	.
 		//	Y	-2																		.
 		//	V	-0																			.
+		// the NCBI files are read as well: '#' comment lines, any column order,
+		// extra columns (B, Z, *) are skipped and an 'X' column scores unknown residues.
 		std::fstream fs(blofile);
 
 		if(fs.is_open())
 		{
-			// allocate space.
-			AllocateSpace();
+			memset(m_Matrix_, 0, sizeof(m_Matrix_));
 
-			// read the file.
 			std::string line;
-			std::getline(fs, line);
-			// read the protein name.
-			for(char ch : line)
+			// read the protein names, the first line that is not a comment.
+			std::vector<int> columns;
+			while(columns.empty() && std::getline(fs, line))
 			{
-				if(ch != ' ')
+				if(line.empty() || line[0] == '#')
+					continue;
+				for(char ch : line)
 				{
-					m_Proteins_ += std::string(1, ch);
+					if(!isspace((unsigned char)ch))
+						columns.push_back(Column(ch));
 				}
 			}
+
 			// read the matrix.
-			char protein = ' ';
-			T value = 0;
-			size_t proteinLine = 0, count = 0;
-			while(count < s_ProteinNumber_)
+			bool seen[s_Alphabet_] = { false };
+			while(std::getline(fs, line))
 			{
-				// read a line.
-				std::getline(fs, line);
 				std::stringstream ss(line);
-				// read the protein name and it's line number.
 				char protein;
-				ss >> protein;
-				proteinLine = m_Proteins_.find(protein);
+				if(!(ss >> protein) || protein == '#')
+					continue;
+				int row = Column(protein);
 				// read the values correspond to this protein.
+				T value = 0;
+				for(size_t k = 0; k < columns.size() && (ss >> value); ++k)
+				{
+					if(row >= 0 && columns[k] >= 0)
+						m_Matrix_[row*s_Alphabet_ + columns[k]] = value;
+				}
+				if(row >= 0)
+					seen[row] = true;
+			}
+
+			// without an 'X', unknown residues get the lowest score of the matrix.
+			if(!seen[g_ResidueUnknown])
+			{
+				T lowest = m_Matrix_[0];
 				for(size_t i = 0; i < s_ProteinNumber_; ++i)
 				{
-					ss >> value;
-					m_Matrix_[proteinLine][i] = value;
+					for(size_t j = 0; j < s_ProteinNumber_; ++j)
+						lowest = std::min(lowest, m_Matrix_[i*s_Alphabet_ + j]);
+				}
+				for(size_t k = 0; k < s_Alphabet_; ++k)
+				{
+					m_Matrix_[g_ResidueUnknown*s_Alphabet_ + k] = lowest;
+					m_Matrix_[k*s_Alphabet_ + g_ResidueUnknown] = lowest;
 				}
-				++count;
 			}
 
+			m_Loaded_ = true;
+			for(size_t k = 0; k < s_ProteinNumber_; ++k)
+				m_Loaded_ = m_Loaded_ && seen[k];
+
 			fs.close();
 		}
 	}
 
+	// matrix_[i][j] scores proteins_[i] against proteins_[j].
 	BloSum62(const T **matrix_, const std::string& proteins_) :
-		m_Proteins_(proteins_)
+		m_Loaded_(true)
 	{
-		// allocate new space.
-		AllocateSpace();
+		memset(m_Matrix_, 0, sizeof(m_Matrix_));
 		// copy data.
-		for(size_t i = 0; i < s_ProteinNumber_; ++i)
+		for(size_t i = 0; i < proteins_.length(); ++i)
 		{
-			memcpy(m_Matrix_[i], matrix_, sizeof(T)*s_ProteinNumber_);
+			for(size_t j = 0; j < proteins_.length(); ++j)
+				m_Matrix_[EncodeResidue(proteins_[i])*s_Alphabet_ + EncodeResidue(proteins_[j])] = matrix_[i][j];
 		}
 	}
 
-	BloSum62(const BloSum62& other_)
+	// whether every residue got a row.
+	inline bool IsLoaded() const
 	{
-		if(this != &other_)
-		{
-			// copy protein information.
-			this->m_Proteins_ = other_.m_Proteins_;
-			// allocate new space.
-			this->AllocateSpace();
-			// copy the matrix.
-			for(size_t i = 0; i < s_ProteinNumber_; ++i)
-			{
-				memcpy(this->m_Matrix_[i], other_.m_Matrix_[i], sizeof(int)*s_ProteinNumber_);
-			}
-		}
+		return m_Loaded_;
 	}
 
-	~BloSum62()
+	// s_Alphabet_ x s_Alphabet_, row-major, indexed by residue code.
+	inline const T* GetMatrix() const
 	{
-		ReleaseSpace();
+		return m_Matrix_;
 	}
 
-	int** GetBloSum62Matrix() const
+	std::string GetProteins() const
 	{
-		return m_Matrix_;
+		return std::string(g_Residues);
 	}
 
-	std::string GetProteins() const
+	// score of two residue codes.
+	inline T GetScore(unsigned char c1, unsigned char c2) const
 	{
-		return m_Proteins_;
+		assert(c1 < s_Alphabet_ && c2 < s_Alphabet_);
+		return m_Matrix_[c1*s_Alphabet_ + c2];
 	}
 
-	int GetValue(char p1, char p2) const
+	// score of two residue letters.
+	inline T GetValue(char p1, char p2) const
 	{
-		int p1Idx = m_Proteins_.find(p1), p2Idx = m_Proteins_.find(p2);
-		assert(p1Idx != std::string::npos && p2Idx != std::string::npos);
-		return m_Matrix_[p1Idx][p2Idx];
+		return GetScore(EncodeResidue(p1), EncodeResidue(p2));
+	}
+
+	// residue codes of a sequence.
+	static void Encode(const std::string& sequence_, std::vector<unsigned char>& codes_)
+	{
+		codes_.resize(sequence_.length());
+		for(size_t k = 0; k < sequence_.length(); ++k)
+			codes_[k] = EncodeResidue(sequence_[k]);
 	}
 
 	void Print() const
 	{
 		// print header.
-		for(size_t i = 0; i < s_ProteinNumber_; ++i)
-			std::cout << "\t" << m_Proteins_[i];
+		for(size_t i = 0; i < s_Alphabet_; ++i)
+			std::cout << "\t" << DecodeResidue((unsigned char)i);
 		std::cout << std::endl;
 
 		// print body.
-		for(size_t i = 0; i < s_ProteinNumber_; ++i)
+		for(size_t i = 0; i < s_Alphabet_; ++i)
 		{
 			// print the name of this protein.
-			std::cout << m_Proteins_[i];
+			std::cout << DecodeResidue((unsigned char)i);
 			// print the value.
-			for(size_t j = 0; j < s_ProteinNumber_; ++j)
+			for(size_t j = 0; j < s_Alphabet_; ++j)
 			{
-				std::cout << "\t" << m_Matrix_[i][j];
+				std::cout << "\t" << m_Matrix_[i*s_Alphabet_ + j];
 			}
 			std::cout << std::endl;
 		}
 	}
 
 private:
-	void AllocateSpace()
-	{
-		// release space.
-		ReleaseSpace();
-		// allocate new space.
-		m_Matrix_ = new int*[s_ProteinNumber_];
-		for(size_t i = 0; i < s_ProteinNumber_; ++i)
-		{
-			m_Matrix_[i] = new int[s_ProteinNumber_];
-			memset(m_Matrix_[i], (T)0, sizeof(T)*s_ProteinNumber_);
-		}
-	}
-
-	void ReleaseSpace()
+	// the row/column of a letter in m_Matrix_, -1 for letters that are not kept.
+	static int Column(char ch)
 	{
-		if(m_Matrix_ != nullptr)
-		{
-			for(size_t i = 0; i < s_ProteinNumber_; ++i)
-			{
-				if(m_Matrix_[i] != nullptr)
-				{
-					delete[] m_Matrix_[i];
-				}
-			}
-			delete[] m_Matrix_, m_Matrix_ = nullptr;
-		}
+		unsigned char code = EncodeResidue(ch);
+		if(code == g_ResidueUnknown)
+			return (toupper((unsigned char)ch) == 'X') ? (int)g_ResidueUnknown : -1;
+		return (int)code;
 	}
 
 public:
 	static const size_t s_ProteinNumber_;
+	static constexpr size_t s_Alphabet_ = g_ResidueCount + 1;
 private:
-	T **m_Matrix_;
-	std::string m_Proteins_;
+	alignas(64) T m_Matrix_[s_Alphabet_*s_Alphabet_];
+	bool m_Loaded_;
 };
 
 template <typename T>
 const size_t BloSum62<T>::s_ProteinNumber_ = 20;
 
+template <typename T>
+constexpr size_t BloSum62<T>::s_Alphabet_;
+
+// the scores of every residue against each position of one query: row r holds score(r, query[j]) for all j.
+// built once per query and shared by the solvers of all its targets, the kernels read a row straight through.
+template <typename T>
+class QueryProfile
+{
+public:
+	QueryProfile() :
+		m_Length_(0)
+	{}
+	QueryProfile(const BloSum62<T>& matrix_, const unsigned char* query_, size_t length_) :
+		m_Length_(0)
+	{
+		Assign(matrix_, query_, length_);
+	}
+
+	// the profile of another query, the scores keep their capacity.
+	void Assign(const BloSum62<T>& matrix_, const unsigned char* query_, size_t length_)
+	{
+		m_Length_ = length_;
+		m_Scores_.resize(BloSum62<T>::s_Alphabet_*length_);
+		for(size_t r = 0; r < BloSum62<T>::s_Alphabet_; ++r)
+		{
+			T* row = m_Scores_.data() + r*m_Length_;
+			for(size_t j = 0; j < m_Length_; ++j)
+				row[j] = matrix_.GetScore((unsigned char)r, query_[j]);
+		}
+	}
+
+	inline size_t GetLength() const
+	{
+		return m_Length_;
+	}
+	inline const T* GetRow(unsigned char residue_) const
+	{
+		return m_Scores_.data() + residue_*m_Length_;
+	}
+
+private:
+	size_t m_Length_;
+	std::vector<T> m_Scores_;
+};
+
 #endif	// __BLOSUM62_HXX__
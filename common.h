@@ -11,6 +11,8 @@
 #include <vector>
 #include <map>
 #include <memory.h>
+#include <array>
+#include <cctype>
 
 #include "sequence.h"
 
@@ -23,6 +25,35 @@ typedef std::pair<std::string, std::string> SeqPair;
 
 
 //constexpr int NEGINF = INT_MIN;
-constexpr int NEGINF = -10000;
+// far below any real score (-10000 was reached by titin-sized pairs), and still far from wrapping an int when penalties are subtracted.
+constexpr int NEGINF = -(1 << 28);
+
+// residue letters in the order of the BLOSUM62 file, a residue is stored as its index here.
+constexpr const char* g_Residues = "ARNDCQEGHILKMFPSTWYV";
+constexpr size_t g_ResidueCount = 20;
+// any other letter (X, B, Z, U, ...).
+constexpr unsigned char g_ResidueUnknown = 20;
+
+// the index of a residue letter in either case, g_ResidueUnknown for anything else.
+inline unsigned char EncodeResidue(char ch)
+{
+	static const std::array<unsigned char, 256> table = []() {
+		std::array<unsigned char, 256> codes;
+		codes.fill(g_ResidueUnknown);
+		for(size_t k = 0; k < g_ResidueCount; ++k)
+		{
+			codes[(unsigned char)g_Residues[k]] = (unsigned char)k;
+			codes[(unsigned char)tolower(g_Residues[k])] = (unsigned char)k;
+		}
+		return codes;
+	}();
+	return table[(unsigned char)ch];
+}
+
+// the letter of a residue index.
+inline char DecodeResidue(unsigned char code)
+{
+	return (code < g_ResidueCount) ? g_Residues[code] : 'X';
+}
 
 #endif		// __COMMON_H__
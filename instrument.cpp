@@ -0,0 +1,45 @@
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+#include "instrument.h"
+
+size_t GetPeakMemory()
+{
+#if defined(_WIN32)
+	return 0;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return (size_t)usage.ru_maxrss;			// bytes
+#else
+	return (size_t)usage.ru_maxrss*1024;	// kilobytes
+#endif
+#endif
+}
+
+std::string JsonString(const std::string& value_)
+{
+	static const char* s_Hex = "0123456789abcdef";
+	std::string json(1, '"');
+	for(char ch : value_)
+	{
+		if(ch == '"' || ch == '\\')
+		{
+			json += '\\';
+			json += ch;
+		}
+		else if((unsigned char)ch < 0x20)
+		{
+			json += "\\u00";
+			json += s_Hex[(unsigned char)ch >> 4];
+			json += s_Hex[ch & 0xF];
+		}
+		else
+			json += ch;
+	}
+	json += '"';
+	return json;
+}
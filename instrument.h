@@ -0,0 +1,50 @@
+#ifndef __INSTRUMENT_H__
+#define __INSTRUMENT_H__
+
+#include <chrono>
+
+#include "common.h"
+
+// wall time on the steady clock, in seconds.
+class Stopwatch
+{
+public:
+	Stopwatch() :
+		m_Start_(std::chrono::steady_clock::now())
+	{}
+
+	inline void Restart()
+	{
+		m_Start_ = std::chrono::steady_clock::now();
+	}
+	// the seconds since construction or the last Restart() / Lap().
+	inline double GetSeconds() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start_).count();
+	}
+	// GetSeconds(), and restart: the time of one phase after the other.
+	inline double Lap()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(now - m_Start_).count();
+		m_Start_ = now;
+		return seconds;
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_Start_;
+};
+
+// billions of dp cells per second, 0 for no time.
+inline double GetGcups(double cells_, double seconds_)
+{
+	return (seconds_ > 0.0) ? cells_/seconds_*1e-9 : 0.0;
+}
+
+// the peak resident memory of the process in bytes, 0 where the platform does not tell.
+size_t GetPeakMemory();
+
+// value_ as a quoted JSON string.
+std::string JsonString(const std::string& value_);
+
+#endif	// __INSTRUMENT_H__
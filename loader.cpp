@@ -0,0 +1,238 @@
+#include <cctype>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "loader.h"
+
+// not a residue: line breaks, blanks, the '*' stop of FASTA.
+static constexpr unsigned char s_Skip = 0xFF;
+
+SequenceStore::SequenceStore() :
+	m_Data_(nullptr), m_Size_(0), m_Mapped_(false)
+{}
+
+SequenceStore::~SequenceStore()
+{
+	Release();
+}
+
+bool SequenceStore::Open(const std::string& seqfile)
+{
+	Release();
+
+#if defined(_WIN32)
+	// no mmap here, one read of the whole file instead.
+	std::ifstream fs(seqfile, std::ios::binary | std::ios::ate);
+	if(!fs.is_open())
+		return false;
+	m_Size_ = (size_t)fs.tellg();
+	char* buffer = new char[m_Size_ + 1];
+	fs.seekg(0);
+	fs.read(buffer, m_Size_);
+	m_Data_ = buffer;
+#else
+	int fd = open(seqfile.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	m_Size_ = (size_t)st.st_size;
+	if(m_Size_ > 0)
+	{
+		void* data = mmap(nullptr, m_Size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED)
+		{
+			close(fd);
+			m_Size_ = 0;
+			return false;
+		}
+		madvise(data, m_Size_, MADV_SEQUENTIAL);
+		m_Data_ = (const char*)data;
+		m_Mapped_ = true;
+	}
+	close(fd);
+#endif
+
+	Parse();
+	return true;
+}
+
+void SequenceStore::Release()
+{
+	if(m_Data_ != nullptr)
+	{
+#if defined(_WIN32)
+		delete[] m_Data_;
+#else
+		if(m_Mapped_)
+			munmap((void*)m_Data_, m_Size_);
+#endif
+	}
+	m_Data_ = nullptr;
+	m_Size_ = 0;
+	m_Mapped_ = false;
+	m_Arena_.clear();
+	m_Views_.clear();
+	m_Letters_.clear();
+	m_Index_.clear();
+}
+
+void SequenceStore::Parse()
+{
+	// letter -> residue index, and the letters the code does not give back.
+	unsigned char table[256];
+	bool keep[256];
+	for(int ch = 0; ch < 256; ++ch)
+	{
+		table[ch] = isalpha(ch) ? EncodeResidue((char)ch) : s_Skip;
+		keep[ch] = isalpha(ch) && DecodeResidue(table[ch]) != (char)ch;
+	}
+
+	// at most one residue per byte, trimmed at the end.
+	m_Arena_.resize(m_Size_);
+	unsigned char* arena = m_Arena_.data();
+	size_t fill = 0;
+
+	const char* ptr = m_Data_;
+	const char* end = m_Data_ + m_Size_;
+
+	// FASTA when the first thing in the file is a '>' header.
+	const char* first = ptr;
+	while(first < end && isspace((unsigned char)*first))
+		++first;
+	bool fasta = (first < end && *first == '>');
+
+	SequenceView view = { nullptr, 0, nullptr, 0, 0, 0 };
+	bool open = false;
+	auto finish = [this, &view, &open, &fill]() {
+		view.length = fill - view.offset;
+		if(open && view.nameLength > 0 && view.length > 0)
+		{
+			m_Index_[NameKey{ view.name, view.nameLength }].push_back(m_Views_.size());
+			m_Views_.push_back(view);
+		}
+		else
+		{
+			// drop the residues of an unnamed or empty record.
+			fill = view.offset;
+			while(!m_Letters_.empty() && m_Letters_.back().first >= fill)
+				m_Letters_.pop_back();
+		}
+		open = false;
+	};
+
+	while(ptr < end)
+	{
+		const char* eol = (const char*)memchr(ptr, '\n', end - ptr);
+		if(eol == nullptr)
+			eol = end;
+		// lines written on windows end with '\r'.
+		const char* lineEnd = eol;
+		if(lineEnd > ptr && lineEnd[-1] == '\r')
+			--lineEnd;
+
+		// seqfile format: a header is any line with a space in it.
+		bool header = fasta ? (ptr < lineEnd && *ptr == '>') : (memchr(ptr, ' ', lineEnd - ptr) != nullptr);
+		if(header)
+		{
+			if(open)
+				finish();
+
+			// "name species" or ">name description".
+			const char* name = fasta ? ptr + 1 : ptr;
+			const char* nameEnd = name;
+			while(nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t')
+				++nameEnd;
+			const char* species = (nameEnd < lineEnd) ? nameEnd + 1 : lineEnd;
+
+			view.name = name;
+			view.nameLength = nameEnd - name;
+			view.species = species;
+			view.speciesLength = lineEnd - species;
+			view.offset = fill;
+			view.length = 0;
+			open = true;
+		}
+		else if(open)
+		{
+			// locals: the byte stores could alias fill and view otherwise.
+			size_t pos = fill;
+			for(const char* ch = ptr; ch < lineEnd; ++ch)
+			{
+				unsigned char code = table[(unsigned char)*ch];
+				if(keep[(unsigned char)*ch])
+					m_Letters_.push_back(std::make_pair(pos, *ch));
+				arena[pos] = code;
+				pos += (code != s_Skip);
+			}
+			fill = pos;
+		}
+
+		ptr = eol + 1;
+	}
+	if(open)
+		finish();
+
+	// keep the capacity, shrinking would copy the whole arena for the few bytes of headers and line breaks.
+	m_Arena_.resize(fill);
+}
+
+void SequenceStore::GetPairs(ePairing pairing_, ViewPairList& pairs_) const
+{
+	for(size_t k = 0; k < m_Views_.size(); ++k)
+	{
+		const SequenceView& view = m_Views_[k];
+
+		// the earlier sequences of this name come before k in the group.
+		const std::vector<size_t>& group = m_Index_.find(NameKey{ view.name, view.nameLength })->second;
+		for(size_t other : group)
+		{
+			if(other >= k)
+				break;
+			pairs_.push_back(ViewPair(other, k));
+			if(pairing_ == ePairing::PairFirst)
+				break;
+		}
+	}
+}
+
+std::string SequenceStore::Decode(size_t index_) const
+{
+	std::string sequence;
+	Decode(index_, sequence);
+	return sequence;
+}
+
+void SequenceStore::Decode(size_t index_, std::string& sequence_) const
+{
+	// resize keeps the capacity, a reused string does not allocate.
+	const SequenceView& view = m_Views_[index_];
+	const unsigned char* residues = GetResidues(index_);
+	sequence_.resize(view.length);
+	for(size_t k = 0; k < view.length; ++k)
+		sequence_[k] = DecodeResidue(residues[k]);
+
+	// the letters of the file where the codes lose them, m_Letters_ is in arena order.
+	auto letter = std::lower_bound(m_Letters_.begin(), m_Letters_.end(), view.offset,
+		[](const std::pair<size_t, char>& entry_, size_t offset_) { return entry_.first < offset_; });
+	for(; letter != m_Letters_.end() && letter->first < view.offset + view.length; ++letter)
+		sequence_[letter->first - view.offset] = letter->second;
+}
+
+Sequence SequenceStore::ToSequence(size_t index_) const
+{
+	const SequenceView& view = m_Views_[index_];
+	return Sequence(view.GetSequenceName(), view.GetSpecies(), Decode(index_));
+}
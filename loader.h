@@ -0,0 +1,110 @@
+#ifndef __LOADER_H__
+#define __LOADER_H__
+
+#include <unordered_map>
+
+#include "common.h"
+
+// a sequence inside a SequenceStore: name and species point into the mapped file, residues into the arena.
+struct SequenceView
+{
+	const char* name;
+	size_t nameLength;
+	const char* species;
+	size_t speciesLength;
+	size_t offset;			// first residue in the arena
+	size_t length;
+
+	std::string GetSequenceName() const
+	{
+		return std::string(name, nameLength);
+	}
+	std::string GetSpecies() const
+	{
+		return std::string(species, speciesLength);
+	}
+};
+
+// two sequences of a store, by index.
+typedef std::pair<size_t, size_t> ViewPair;
+typedef std::vector<ViewPair> ViewPairList;
+
+typedef enum
+{
+	PairFirst,		// the first sequence of a name against each later one (GetProteinSequencePairs)
+	PairAll			// every two sequences of a name
+} ePairing;
+
+// a sequence file mapped into memory and parsed once.
+// both the seqfile format (see GetProteinSequencePairs) and FASTA ('>' header lines) are read.
+class SequenceStore
+{
+public:
+	SequenceStore();
+	~SequenceStore();
+
+	// returns false if the file can not be opened.
+	bool Open(const std::string& seqfile);
+
+	inline size_t Size() const
+	{
+		return m_Views_.size();
+	}
+	inline const SequenceView& Get(size_t index_) const
+	{
+		return m_Views_[index_];
+	}
+	inline const unsigned char* GetResidues(size_t index_) const
+	{
+		return m_Arena_.data() + m_Views_[index_].offset;
+	}
+
+	// pairs of sequences with the same name, ordered by the later sequence of the pair.
+	void GetPairs(ePairing pairing_, ViewPairList& pairs_) const;
+
+	// the residue letters of a sequence as in the file, and a Sequence built from them.
+	// the arena holds codes, lowercase letters and letters outside g_Residues (B, Z, U, ...) are patched in
+	// from m_Letters_. they score as their code: the uppercase residue, or 'X'.
+	std::string Decode(size_t index_) const;
+	void Decode(size_t index_, std::string& sequence_) const;
+	Sequence ToSequence(size_t index_) const;
+
+private:
+	void Parse();
+	void Release();
+
+	// name -> sequence indices, keyed by the name inside the mapping.
+	struct NameKey
+	{
+		const char* name;
+		size_t length;
+
+		bool operator== (const NameKey& other_) const
+		{
+			return length == other_.length && memcmp(name, other_.name, length) == 0;
+		}
+	};
+	struct NameHash
+	{
+		size_t operator() (const NameKey& key_) const
+		{
+			// FNV-1a
+			size_t hash = 14695981039346656037ull;
+			for(size_t k = 0; k < key_.length; ++k)
+				hash = (hash ^ (unsigned char)key_.name[k])*1099511628211ull;
+			return hash;
+		}
+	};
+
+private:
+	const char* m_Data_;
+	size_t m_Size_;
+	bool m_Mapped_;
+
+	std::vector<unsigned char> m_Arena_;
+	std::vector<SequenceView> m_Views_;
+	std::vector<std::pair<size_t, char>> m_Letters_;		// arena position -> letter, where DecodeResidue() gives another letter
+	std::unordered_map<NameKey, std::vector<size_t>, NameHash> m_Index_;
+};
+
+#endif	// __LOADER_H__
@@ -4,12 +4,18 @@
 #include <utility>
 #include <map>
 #include <exception>
+#include <thread>
+#include <algorithm>
 
 #include "sequence.h"
 #include "common.h"
 #include "utils.h"
+#include "loader.h"
 #include "solver.hxx"
-#include "bloSum62.hxx"
+#include "blosum62.hxx"
+#include "batch.h"
+#include "search.h"
+#include "instrument.h"
 
 using namespace std;
 
@@ -18,12 +24,35 @@ int main(int argc, char* argv[])
 	// argument judgement.
 	if(argc < 3)
 	{
-		cout << "usage: program sequence_file blosum62_file" << endl;
+		cout << "usage: program sequence_file blosum62_file [options]" << endl;
+		cout << "options: " << endl;
+		cout << "--full	---	always keep the traces of the whole matrix" << endl;
+		cout << "--linear	---	always align in linear memory" << endl;
+		cout << "--linear-cells N	---	align in linear memory above N matrix cells (default " << Solver<int>::s_LinearCells_ << ")" << endl;
+		cout << "--threads N	---	align on N threads (default: all cores)" << endl;
+		cout << "--wavefront-cells N	---	split a pair above N matrix cells into tiles on all threads (default " << Solver<int>::s_WavefrontCells_ << ")" << endl;
+		cout << "--buffer N	---	hold at most N finished pairs for in-order output (default 32 per thread)" << endl;
+		cout << "--all-pairs	---	compare every two sequences of a seqname, not only the first with the others" << endl;
+		cout << "--band W	---	only align the diagonals at most W away from the length difference (0: |m - n| + " << Solver<int>::s_BandSlack_ << ")" << endl;
+		cout << "--xdrop X	---	drop the cells more than X below the best score so far" << endl;
+		cout << "			a pair the band or the X-drop may have cut off is marked 'limited', rerun it without." << endl;
+		cout << "			the mark is a heuristic: an unmarked pair can still score below the full alignment." << endl;
+		cout << "--search query_file	---	search each sequence of query_file against all of sequence_file instead of comparing seqnames" << endl;
+		cout << "			the hits are ranked and aligned by their best local alignment, --band and --xdrop do not apply." << endl;
+		cout << "--top K	---	search: align and report the K best hits per query (default " << SearchOptions().top << ")" << endl;
+		cout << "--kmer K	---	search: seed words of K residues, 1 to 5 (default " << SearchOptions().k << ")" << endl;
+		cout << "--min-seeds N	---	search: score the targets sharing at least N seed words with the query (default " << SearchOptions().minSeeds << ")" << endl;
+		cout << "--candidates N	---	search: score at most the N targets with the most seeds, 0 for all (default " << SearchOptions().candidates << ")" << endl;
+		cout << "--no-prefilter	---	search: score every target, to check what the seeds miss" << endl;
+		cout << "--timing json_file	---	write the time and counters of each pair to json_file, one JSON object a line" << endl;
+		cout << "			with --search: of each query and each of its hits." << endl;
 		cout << "sequence_file format: " << endl;
 		cout << "seqname species	---	[1 line]" << endl;
-		cout << "sequence	---	[multiple line]" << endl << endl;
+		cout << "sequence	---	[multiple line]" << endl;
+		cout << "or FASTA, the first word of a '>' line is the seqname." << endl << endl;
 		cout << "notice: each seqname at least appear twice to be compared." << endl;
-		cout << "blosum62_file format: see the file blosum62.hxx" << endl;
+		cout << "blosum62_file format: see the file blosum62.hxx, NCBI matrix files (BLOSUM45/80, PAM...) work too." << endl;
+		cout << "blosum62_file 'builtin' uses the built-in BLOSUM62." << endl;
 
 		return -1;
 	}
@@ -35,38 +64,220 @@ int main(int argc, char* argv[])
 	if(seqFile.empty() || bloFile.empty())
 		return -2;
 
-	// read protein sequence file.
-	ComparePairList cmpList;
-	GetProteinSequencePairs(seqFile, cmpList);
-	cout << "Compare List Size: " << cmpList.size() << endl;	// output the size of sequence pair that need to be analysis.
+	// get options.
+	eMemory memory = eMemory::MemoryAuto;
+	size_t threads = std::max(std::thread::hardware_concurrency(), 1u), buffer = 0;
+	ePairing pairing = ePairing::PairFirst;
+	Region region;
+	std::string queryFile, timingFile;
+	SearchOptions search;
+	for(int k = 3; k < argc; ++k)
+	{
+		std::string option = std::string(argv[k]);
+		if(option == "--full")
+			memory = eMemory::MemoryFull;
+		else if(option == "--linear")
+			memory = eMemory::MemoryLinear;
+		else if(option == "--linear-cells" && k + 1 < argc)
+			Solver<int>::s_LinearCells_ = std::stoull(argv[++k]);
+		else if(option == "--threads" && k + 1 < argc)
+			threads = std::stoull(argv[++k]);
+		else if(option == "--wavefront-cells" && k + 1 < argc)
+			Solver<int>::s_WavefrontCells_ = std::stoull(argv[++k]);
+		else if(option == "--buffer" && k + 1 < argc)
+			buffer = std::stoull(argv[++k]);
+		else if(option == "--all-pairs")
+			pairing = ePairing::PairAll;
+		else if(option == "--band" && k + 1 < argc)
+			region = Region(eRegion::RegionBanded, std::stoull(argv[++k]));
+		else if(option == "--xdrop" && k + 1 < argc)
+			region = Region(eRegion::RegionXDrop, 0, std::stoi(argv[++k]));
+		else if(option == "--search" && k + 1 < argc)
+			queryFile = std::string(argv[++k]);
+		else if(option == "--top" && k + 1 < argc)
+			search.top = std::stoull(argv[++k]);
+		else if(option == "--kmer" && k + 1 < argc)
+			search.k = std::stoull(argv[++k]);
+		else if(option == "--min-seeds" && k + 1 < argc)
+			search.minSeeds = std::stoull(argv[++k]);
+		else if(option == "--candidates" && k + 1 < argc)
+			search.candidates = std::stoull(argv[++k]);
+		else if(option == "--no-prefilter")
+			search.prefilter = false;
+		else if(option == "--timing" && k + 1 < argc)
+			timingFile = std::string(argv[++k]);
+		else
+		{
+			cout << "unknown option: " << option << endl;
+			return -3;
+		}
+	}
+	if(search.k < 1 || search.k > 5)
+	{
+		cout << "--kmer takes 1 to 5 residues" << endl;
+		return -3;
+	}
+	if(!queryFile.empty() && region.kind != eRegion::RegionFull)
+	{
+		cout << "--band and --xdrop do not apply to --search" << endl;
+		return -3;
+	}
+
+	std::ofstream timing;
+	if(!timingFile.empty())
+	{
+		timing.open(timingFile);
+		if(!timing.is_open())
+		{
+			cout << "can not write " << timingFile << endl;
+			return -2;
+		}
+	}
+
+	// map the protein sequence file.
+	Stopwatch watch;
+	SequenceStore store;
+	if(!store.Open(seqFile))
+	{
+		cout << "can not open " << seqFile << endl;
+		return -2;
+	}
+	const double parseTime = watch.Lap();
+	SequenceStore queries;
+	if(!queryFile.empty() && !queries.Open(queryFile))
+	{
+		cout << "can not open " << queryFile << endl;
+		return -2;
+	}
+	ViewPairList cmpList;
+	if(queryFile.empty())
+	{
+		store.GetPairs(pairing, cmpList);
+		cout << "Compare List Size: " << cmpList.size() << endl;	// output the size of sequence pair that need to be analysis.
+	}
+	else
+		cout << "Database Size: " << store.Size() << ", Queries: " << queries.Size() << endl;
 	
 	// read protein BloSum62 file.
-	BloSum62<int> bloSum62(bloFile);
+	BloSum62<int> bloSum62 = (bloFile == "builtin") ? BloSum62<int>() : BloSum62<int>(bloFile);
+	if(!bloSum62.IsLoaded())
+	{
+		cout << "can not read the matrix " << bloFile << endl;
+		return -2;
+	}
 
 	//--------------------------------------------------//
 	// affine-gap local alignment.						//
 	//--------------------------------------------------//
 
-	// align each sequence pair.
-	for(const CompareSeqPair& seqPair : cmpList)
+	size_t limited = 0;
+	if(!queryFile.empty())
 	{
-		// the analysis process can not stop when feeding sequence 'CN1A' & '5016' into the solver.
-		// maybe there are some bug in analysis process.
-		if(seqPair.first.GetSequenceName() != "CN1A" && 
-		   seqPair.first.GetSequenceName() != "5016")
+		// every query against the database, the best hits ranked.
+		DatabaseSearch searcher(store, bloSum62, threads, memory, search);
+		SearchHitList hits;
+		size_t cells = 0;
+		double prefilterTime = 0.0, scoreTime = 0.0, alignTime = 0.0;
+		watch.Restart();
+		for(size_t q = 0; q < queries.Size(); ++q)
 		{
-			// construct a solver to solve this sequence pair.
-			Solver<int> solver(seqPair.first, seqPair.second, bloSum62);
-			// update the three temporary matrix in the solver, and get the final score between the two sequences.
-			int score = solver.Update();
-			// construct the alignment result of the two sequences.
-			SeqPair result = solver.Construct();
-			// output the alignment result.
-			cout << seqPair.first.GetSequenceName() << ": length = " << seqPair.first.GetSequence().length() 
-				<< ", score = "<< score << endl;
-			cout << "seq1: " << result.first << endl;
-			cout << "seq2: " << result.second << endl;
+			Sequence query = queries.ToSequence(q);
+			searcher.Search(query, hits);
+			cout << "Query: " << query.GetSequenceName() << ": length = " << query.GetSequence().length()
+				<< ", candidates = " << searcher.GetCandidates() << ", hits = " << hits.size() << endl;
+
+			// the stages of the query on all threads, then each hit aligned in one thread.
+			if(timing.is_open())
+			{
+				const SearchStats& stats = searcher.GetStats();
+				timing << "{\"query\":" << q << ",\"name\":" << JsonString(query.GetSequenceName()) << ",\"length\":" << query.GetSequence().length()
+					<< ",\"candidates\":" << stats.candidates << ",\"cells\":" << stats.cells << ",\"hits\":" << hits.size()
+					<< ",\"prefilter_s\":" << stats.prefilterTime << ",\"score_s\":" << stats.scoreTime << ",\"align_s\":" << stats.alignTime
+					<< ",\"gcups\":" << GetGcups((double)stats.cells, stats.scoreTime) << "}" << endl;
+				cells += stats.cells;
+				prefilterTime += stats.prefilterTime;
+				scoreTime += stats.scoreTime;
+				alignTime += stats.alignTime;
+			}
+
+			for(size_t h = 0; h < hits.size(); ++h)
+			{
+				const SearchHit& hit = hits[h];
+				const SequenceView& target = store.Get(hit.target);
+				if(timing.is_open())
+				{
+					const size_t hitCells = (hit.targetEnd - hit.targetBegin + 1)*(hit.queryEnd - hit.queryBegin + 1);
+					timing << "{\"query\":" << q << ",\"hit\":" << h + 1 << ",\"target\":" << JsonString(target.GetSequenceName())
+						<< ",\"length\":" << target.length << ",\"score\":" << hit.score << ",\"seeds\":" << hit.seeds
+						<< ",\"query_begin\":" << hit.queryBegin << ",\"query_end\":" << hit.queryEnd
+						<< ",\"target_begin\":" << hit.targetBegin << ",\"target_end\":" << hit.targetEnd << ",\"cells\":" << ((hit.score > 0) ? hitCells : 0)
+						<< ",\"locate_s\":" << hit.locateTime << ",\"fill_s\":" << hit.fillTime << ",\"traceback_s\":" << hit.traceTime << "}" << endl;
+				}
+
+				cout << h + 1 << ". " << target.GetSequenceName() << ": length = " << target.length << ", score = " << hit.score;
+				if(search.prefilter)
+					cout << ", seeds = " << hit.seeds;
+				cout << ", query = " << hit.queryBegin << "-" << hit.queryEnd << ", target = " << hit.targetBegin << "-" << hit.targetEnd << endl;
+				cout << "query:  " << hit.alignment.second << endl;
+				cout << "target: " << hit.alignment.first << endl;
+			}
 		}
+
+		// the whole search: wall time, and the sums of the queries.
+		if(timing.is_open())
+		{
+			const double searchTime = watch.GetSeconds();
+			timing << "{\"summary\":true,\"sequences\":" << store.Size() << ",\"queries\":" << queries.Size() << ",\"threads\":" << threads
+				<< ",\"cells\":" << cells << ",\"parse_s\":" << parseTime << ",\"search_s\":" << searchTime
+				<< ",\"prefilter_s\":" << prefilterTime << ",\"score_s\":" << scoreTime << ",\"align_s\":" << alignTime
+				<< ",\"gcups\":" << GetGcups((double)cells, scoreTime) << ",\"peak_bytes\":" << GetPeakMemory() << "}" << endl;
+		}
+		return 0;
+	}
+
+	// align the sequence pairs on all threads, the results come back in input order.
+	if(buffer == 0)
+		buffer = 32*threads;
+	size_t pair = 0, cells = 0;
+	double fillTime = 0.0, traceTime = 0.0;
+	watch.Restart();
+	BatchAligner aligner(store, cmpList, bloSum62, threads, buffer, memory, region);
+	aligner.Run([&](const SequenceView& seq1, const SequenceView& seq2, const BatchResult& result) {
+		// the counters of the pair, fill and traceback in the thread that aligned it.
+		if(timing.is_open())
+		{
+			// the cells the solver computed: fewer than (m+1)*(n+1) with a band or an X-drop.
+			const size_t pairCells = result.cells;
+			timing << "{\"pair\":" << pair << ",\"seq1\":" << JsonString(seq1.GetSequenceName()) << ",\"seq2\":" << JsonString(seq2.GetSequenceName())
+				<< ",\"length1\":" << seq1.length << ",\"length2\":" << seq2.length << ",\"cells\":" << pairCells
+				<< ",\"score\":" << result.score << ",\"linear\":" << (result.linear ? "true" : "false") << ",\"limited\":" << (result.limited ? "true" : "false")
+				<< ",\"decode_s\":" << result.decodeTime << ",\"fill_s\":" << result.fillTime << ",\"traceback_s\":" << result.traceTime
+				<< ",\"gcups\":" << GetGcups((double)pairCells, result.fillTime) << "}" << endl;
+			cells += pairCells;
+			fillTime += result.fillTime;
+			traceTime += result.traceTime;
+		}
+		++pair;
+
+		// output the alignment result.
+		cout << seq1.GetSequenceName() << ": length = " << seq1.length 
+			<< ", score = "<< result.score << (result.limited ? ", limited" : "") << endl;
+		limited += result.limited;
+		cout << "seq1: " << result.alignment.first << endl;
+		cout << "seq2: " << result.alignment.second << endl;
+	});
+	if(region.kind != eRegion::RegionFull)
+		cout << "Limited Pairs: " << limited << endl;
+
+	// the whole run: wall time on all threads, and the sums of the pairs. gcups is over the summed fill times
+	// as for a pair, wall_gcups over the wall time with traceback and output.
+	if(timing.is_open())
+	{
+		const double alignTime = watch.GetSeconds();
+		timing << "{\"summary\":true,\"sequences\":" << store.Size() << ",\"pairs\":" << pair << ",\"threads\":" << threads << ",\"cells\":" << cells
+			<< ",\"parse_s\":" << parseTime << ",\"align_s\":" << alignTime << ",\"fill_s\":" << fillTime << ",\"traceback_s\":" << traceTime
+			<< ",\"gcups\":" << GetGcups((double)cells, fillTime) << ",\"wall_gcups\":" << GetGcups((double)cells, alignTime)
+			<< ",\"peak_bytes\":" << GetPeakMemory() << "}" << endl;
 	}
 
 	return 0;
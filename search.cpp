@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <thread>
+
+#include "search.h"
+
+// f(word) for every word of k known residues of codes_, from left to right.
+template <typename F>
+static void ForEachWord(const unsigned char* codes_, size_t length_, size_t k_, size_t words_, F f)
+{
+	size_t word = 0, known = 0;
+	for(size_t p = 0; p < length_; ++p)
+	{
+		if(codes_[p] >= g_ResidueCount)
+		{
+			known = 0;
+			continue;
+		}
+		word = (word*g_ResidueCount + codes_[p]) % words_;
+		if(++known >= k_)
+			f(word);
+	}
+}
+
+SeedIndex::SeedIndex(const SequenceStore& store_, size_t k_) :
+	m_Store_(store_), m_K_(k_)
+{
+	assert(m_K_ > 0);
+	size_t words = 1;
+	for(size_t k = 0; k < m_K_; ++k)
+		words *= g_ResidueCount;
+
+	// count the sequences of each word, then place them. last[w] is the last sequence seen with word w,
+	// so a sequence is listed once however often it has the word.
+	std::vector<size_t> last(words, m_Store_.Size());
+	m_Starts_.assign(words + 1, 0);
+	for(size_t t = 0; t < m_Store_.Size(); ++t)
+	{
+		ForEachWord(m_Store_.GetResidues(t), m_Store_.Get(t).length, m_K_, words, [this, &last, t](size_t w) {
+			if(last[w] != t)
+			{
+				last[w] = t;
+				++m_Starts_[w + 1];
+			}
+		});
+	}
+	for(size_t w = 0; w < words; ++w)
+		m_Starts_[w + 1] += m_Starts_[w];
+
+	std::vector<size_t> fill(m_Starts_.begin(), m_Starts_.end() - 1);
+	last.assign(words, m_Store_.Size());
+	m_Postings_.resize(m_Starts_[words]);
+	for(size_t t = 0; t < m_Store_.Size(); ++t)
+	{
+		ForEachWord(m_Store_.GetResidues(t), m_Store_.Get(t).length, m_K_, words, [this, &last, &fill, t](size_t w) {
+			if(last[w] != t)
+			{
+				last[w] = t;
+				m_Postings_[fill[w]++] = t;
+			}
+		});
+	}
+}
+
+void SeedIndex::Count(const unsigned char* query_, size_t length_, std::vector<size_t>& seeds_) const
+{
+	seeds_.assign(m_Store_.Size(), 0);
+	ForEachWord(query_, length_, m_K_, m_Starts_.size() - 1, [this, &seeds_](size_t w) {
+		for(size_t p = m_Starts_[w]; p < m_Starts_[w + 1]; ++p)
+			++seeds_[m_Postings_[p]];
+	});
+}
+
+DatabaseSearch::DatabaseSearch(const SequenceStore& database_, const BloSum62<int>& blosum62_, size_t threads_, eMemory memory_, const SearchOptions& options_) :
+	m_Database_(database_), m_BloSum62_(blosum62_),
+	m_Threads_(std::max<size_t>(threads_, 1)), m_Memory_(memory_), m_Options_(options_), m_Wavefront_(m_Threads_),
+	m_Workers_(m_Threads_), m_Stats_()
+{
+	if(m_Options_.prefilter)
+		m_Index_.reset(new SeedIndex(m_Database_, m_Options_.k));
+}
+
+void DatabaseSearch::Search(const Sequence& query_, SearchHitList& hits_)
+{
+	Stopwatch watch;
+	BloSum62<int>::Encode(query_.GetSequence(), m_Query_);
+
+	// the candidates: every target, or the ones with enough seeds, the most seeds first.
+	m_Scored_.clear();
+	if(m_Index_)
+		m_Index_->Count(m_Query_.data(), m_Query_.size(), m_Seeds_);
+	for(size_t t = 0; t < m_Database_.Size(); ++t)
+	{
+		if(m_Index_ && m_Seeds_[t] < m_Options_.minSeeds)
+			continue;
+		SearchHit hit = SearchHit();
+		hit.target = t;
+		hit.seeds = m_Index_ ? m_Seeds_[t] : 0;
+		m_Scored_.push_back(hit);
+	}
+	if(m_Index_ && m_Options_.candidates > 0 && m_Scored_.size() > m_Options_.candidates)
+	{
+		std::stable_sort(m_Scored_.begin(), m_Scored_.end(), [](const SearchHit& a_, const SearchHit& b_) { return a_.seeds > b_.seeds; });
+		m_Scored_.resize(m_Options_.candidates);
+	}
+	m_Stats_.candidates = m_Scored_.size();
+	m_Stats_.cells = 0;
+	for(const SearchHit& hit : m_Scored_)
+		m_Stats_.cells += (m_Database_.Get(hit.target).length + 1)*(m_Query_.size() + 1);
+	m_Stats_.prefilterTime = watch.Lap();
+
+	// score the candidates without traces, straight from the residue codes of the database. the query is striped
+	// once for all of them, a target the striped kernels can not score takes the scalar path.
+	m_Striped_.Assign(m_BloSum62_.GetMatrix(), BloSum62<int>::s_Alphabet_, m_Query_.data(), m_Query_.size());
+	QueryProfile<int> profile(m_BloSum62_, m_Query_.data(), m_Query_.size());
+	Parallel(m_Scored_.size(), [this, &query_, &profile](Worker& worker_, const BloSum62<int>& blosum62_, size_t k_) {
+		SearchHit& hit = m_Scored_[k_];
+		int score = 0;
+		if(StripedLocalScore(m_Striped_, m_Database_.GetResidues(hit.target), m_Database_.Get(hit.target).length,
+			(int)Solver<int>::g_Wg, (int)Solver<int>::g_Ws, worker_.rows, score))
+		{
+			hit.score = score;
+			return;
+		}
+		Decode(worker_, hit);
+		Solver<int> solver(worker_.target, query_, blosum62_, eMemory::MemoryLinear, &profile, Region(), nullptr, &worker_.workspace);
+		size_t begin1 = 0, end1 = 0, begin2 = 0, end2 = 0;
+		hit.score = solver.Locate(begin1, end1, begin2, end2);
+	});
+
+	// the best ones, ties in database order.
+	const size_t top = std::min(m_Options_.top, m_Scored_.size());
+	std::partial_sort(m_Scored_.begin(), m_Scored_.begin() + top, m_Scored_.end(), [](const SearchHit& a_, const SearchHit& b_) {
+		return a_.score > b_.score || (a_.score == b_.score && a_.target < b_.target);
+	});
+	hits_.assign(m_Scored_.begin(), m_Scored_.begin() + top);
+	m_Stats_.scoreTime = watch.Lap();
+
+	// the alignments of the top hits only: the span of the local alignment first, then the global alignment of the spans,
+	// which scores the same and takes the memory mode and the wavefront of the search.
+	Parallel(hits_.size(), [this, &query_, &profile, &hits_](Worker& worker_, const BloSum62<int>& blosum62_, size_t k_) {
+		SearchHit& hit = hits_[k_];
+		Stopwatch hitWatch;
+		Decode(worker_, hit);
+		size_t begin1 = 0, end1 = 0, begin2 = 0, end2 = 0;
+		{
+			Solver<int> solver(worker_.target, query_, blosum62_, eMemory::MemoryLinear, &profile, Region(), nullptr, &worker_.workspace);
+			hit.score = solver.Locate(begin1, end1, begin2, end2);
+		}
+		hit.alignment.first.clear();
+		hit.alignment.second.clear();
+		hit.targetBegin = hit.targetEnd = hit.queryBegin = hit.queryEnd = 0;
+		hit.locateTime = hitWatch.Lap();
+		if(hit.score <= 0)
+			return;
+
+		worker_.target.SetSequence(worker_.residues.substr(begin1, end1 - begin1));
+		worker_.query.SetSequence(query_.GetSequence().substr(begin2, end2 - begin2));
+		Solver<int> solver(worker_.target, worker_.query, blosum62_, m_Memory_, nullptr, Region(), &m_Wavefront_, &worker_.workspace);
+		const int score = solver.Update();
+		assert(score == hit.score);
+		(void)score;
+		hit.fillTime = hitWatch.Lap();
+		solver.Construct(hit.alignment);
+		hit.traceTime = hitWatch.Lap();
+		hit.targetBegin = begin1 + 1;
+		hit.targetEnd = end1;
+		hit.queryBegin = begin2 + 1;
+		hit.queryEnd = end2;
+	});
+	m_Stats_.alignTime = watch.Lap();
+}
+
+void DatabaseSearch::Parallel(size_t count_, const SearchTask& task_)
+{
+	std::atomic<size_t> next(0);
+	auto work = [this, count_, &task_, &next](size_t worker_) {
+		// one matrix per thread, shared by all its solvers.
+		BloSum62<int> bloSum62(m_BloSum62_);
+		for(size_t k = next++; k < count_; k = next++)
+			task_(m_Workers_[worker_], bloSum62, k);
+	};
+
+	std::vector<std::thread> threads;
+	for(size_t w = 1; w < std::min(m_Threads_, count_); ++w)
+		threads.push_back(std::thread(work, w));
+	work(0);
+	for(std::thread& thread : threads)
+		thread.join();
+}
+
+void DatabaseSearch::Decode(Worker& worker_, const SearchHit& hit_) const
+{
+	m_Database_.Decode(hit_.target, worker_.residues);
+	worker_.target.SetSequence(worker_.residues);
+}
@@ -0,0 +1,132 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <functional>
+#include <atomic>
+
+#include "common.h"
+#include "blosum62.hxx"
+#include "solver.hxx"
+#include "loader.h"
+#include "wavefront.h"
+#include "instrument.h"
+
+// the words of k residues of every sequence of a SequenceStore, and the sequences holding each word.
+// a word is the base-20 number of its residue codes, words with an unknown residue are left out.
+class SeedIndex
+{
+public:
+	SeedIndex(const SequenceStore& store_, size_t k_);
+
+	inline size_t GetK() const
+	{
+		return m_K_;
+	}
+
+	// seeds_[t]: the positions of the query whose word sequence t holds.
+	void Count(const unsigned char* query_, size_t length_, std::vector<size_t>& seeds_) const;
+
+private:
+	const SequenceStore& m_Store_;
+	size_t m_K_;
+	// word w is held by the sequences m_Postings_[m_Starts_[w] ... m_Starts_[w + 1] - 1], each once.
+	std::vector<size_t> m_Starts_;
+	std::vector<size_t> m_Postings_;
+};
+
+// the settings of a DatabaseSearch.
+struct SearchOptions
+{
+	SearchOptions(size_t k_ = 3, size_t minSeeds_ = 1, size_t candidates_ = 500, size_t top_ = 10, bool prefilter_ = true) :
+		k(k_), minSeeds(minSeeds_), candidates(candidates_), top(top_), prefilter(prefilter_)
+	{}
+
+	size_t k;			// residues of a seed word
+	size_t minSeeds;	// seeds a target needs to be scored
+	size_t candidates;	// targets scored per query at most, the ones with the most seeds. 0 for all of them.
+	size_t top;			// hits aligned and reported per query
+	bool prefilter;		// false: every target is scored, to check what the seeds miss
+};
+
+// a target of a query, the alignment and its coordinates only for the top hits.
+struct SearchHit
+{
+	size_t target;		// index in the database
+	size_t seeds;
+	int score;			// of the best local alignment, see Solver<T>::Locate()
+	SeqPair alignment;	// target, query: the local alignment, empty for a score of 0
+	// the residues the local alignment spans, 1-based and inclusive. 0 - 0 when no residues are aligned.
+	size_t targetBegin, targetEnd, queryBegin, queryEnd;
+	// the top hits: the times of Solver<T>::Locate(), of the fill of the spans and of their traceback.
+	double locateTime, fillTime, traceTime;
+};
+typedef std::vector<SearchHit> SearchHitList;
+
+// the counters of one DatabaseSearch::Search(), the times are wall times of its stages on all threads.
+struct SearchStats
+{
+	size_t candidates;		// targets scored
+	size_t cells;			// (m + 1)*(n + 1) of the targets scored
+	double prefilterTime;	// the seeds and the candidates
+	double scoreTime;		// the scores of the candidates and the ranking
+	double alignTime;		// the alignments of the top hits
+};
+
+// searches queries against every sequence of a database SequenceStore, by the best local alignment (Smith-Waterman),
+// so a short query finds its match inside a long target and the hits rank by that match alone.
+// the seeds shared with the query pick the candidate targets, the candidates are scored without traces
+// (striped from the residue codes of the database when the cpu has a vector unit), and only the best ones are aligned.
+// the stages run on several threads, the query profiles are built once per query and shared by all of them.
+class DatabaseSearch
+{
+public:
+	DatabaseSearch(const SequenceStore& database_, const BloSum62<int>& blosum62_, size_t threads_, eMemory memory_, const SearchOptions& options_);
+
+	// the top hits of query_, best first, ties by database order.
+	void Search(const Sequence& query_, SearchHitList& hits_);
+
+	// the targets the last Search() scored.
+	inline size_t GetCandidates() const
+	{
+		return m_Stats_.candidates;
+	}
+	// the counters of the last Search().
+	inline const SearchStats& GetStats() const
+	{
+		return m_Stats_;
+	}
+
+private:
+	// the buffers of one thread, kept from one query to the next.
+	struct Worker
+	{
+		Workspace<int> workspace;
+		StripedBuffer rows;
+		Sequence target, query;		// the whole target, then the spans of a local alignment
+		std::string residues;
+	};
+	typedef std::function<void(Worker&, const BloSum62<int>&, size_t)> SearchTask;
+
+	// task_(worker, matrix, k) for every k in [0, count_), on all threads.
+	void Parallel(size_t count_, const SearchTask& task_);
+	// the target of hit_ decoded into worker_.
+	void Decode(Worker& worker_, const SearchHit& hit_) const;
+
+private:
+	const SequenceStore& m_Database_;
+	const BloSum62<int>& m_BloSum62_;
+	size_t m_Threads_;
+	eMemory m_Memory_;
+	SearchOptions m_Options_;
+	std::unique_ptr<SeedIndex> m_Index_;
+	Wavefront m_Wavefront_;
+
+	std::vector<Worker> m_Workers_;
+	std::vector<unsigned char> m_Query_;
+	StripedProfile m_Striped_;
+	std::vector<size_t> m_Seeds_;
+	SearchHitList m_Scored_;
+	SearchStats m_Stats_;
+};
+
+#endif	// __SEARCH_H__
@@ -1,8 +1,13 @@
 #ifndef __SOLVER_HXX__
 #define __SOLVER_HXX__
 
+#include <algorithm>
+
 #include "common.h"
 #include "blosum62.hxx"
+#include "striped.h"
+#include "wavefront.h"
+
 
 typedef enum
 {
@@ -12,357 +17,918 @@ typedef enum
 	FromC		// from the matrix C
 } eTrace;
 
+typedef enum
+{
+	MemoryAuto,		// linear memory above Solver<T>::s_LinearCells_ cells
+	MemoryFull,		// the packed traces of the whole (m+1)x(n+1) rectangle, one byte a cell
+	MemoryLinear	// rows only, traceback by divide and conquer
+} eMemory;
+
+typedef enum
+{
+	RegionFull,		// every cell of the (m+1)x(n+1) rectangle
+	RegionBanded,	// the diagonals around the length difference only
+	RegionXDrop		// the cells less than X below the best score so far only
+} eRegion;
+
+// the part of the rectangle a Solver computes. a restricted region keeps the traces of its cells only,
+// Solver<T>::IsLimited() tells whether it may have cut off the best alignment, a heuristic that can miss.
+struct Region
+{
+	Region(eRegion kind_ = eRegion::RegionFull, size_t width_ = 0, int drop_ = 0) :
+		kind(kind_), width(width_), drop(drop_)
+	{}
+
+	eRegion kind;
+	size_t width;	// RegionBanded: diagonals on each side of the centre one, at least |n - m|. 0 derives it from |n - m|.
+	int drop;		// RegionXDrop: X
+};
+
+template <typename T>
+class Solver;
+
+// the buffers of a Solver, kept by one thread from one pair to the next. they only grow, so once they fit
+// the largest pair a Solver does not allocate. a workspace serves one Solver at a time, from its construction
+// to its last Construct().
+template <typename T>
+class Workspace
+{
+public:
+	Workspace()
+	{}
+
+private:
+	friend class Solver<T>;
+
+	// the checkpoint rows of one level of the linear traceback.
+	struct Level
+	{
+		std::vector<size_t> bounds;
+		std::vector<T> marks;
+	};
+
+	// buffer_ with at least size_ elements.
+	template <typename U>
+	static inline U* Fit(std::vector<U>& buffer_, size_t size_)
+	{
+		if(buffer_.size() < size_)
+			buffer_.resize(size_);
+		return buffer_.data();
+	}
+
+private:
+	std::vector<unsigned char> m_Code1_, m_Code2_;
+	QueryProfile<T> m_Profile_;
+
+	std::vector<T> m_Rows_;					// four rows of a sweep, the a, b and c of a row one after the other
+	std::vector<Level> m_Levels_;
+	std::vector<T> m_Tiles_;				// the edges of the tiles of a sweep, and two rows per column of tiles
+	std::vector<size_t> m_Bands_, m_Marks_, m_Sides_;
+	std::vector<unsigned char> m_Trace_;	// packed traces: the whole rectangle, a block of the linear traceback or a region
+	std::vector<size_t> m_Lo_, m_Hi_, m_Offset_;	// restricted regions: the columns of each row and where its traces start
+	std::vector<size_t> m_Starts_;			// Locate(): where the path of each cell of two rows starts
+
+	std::string m_Res1_, m_Res2_;			// the alignment, backwards
+
+	StripedProfile m_Striped_;				// Score(): the query in the lanes of the striped kernels
+	StripedBuffer m_StripedRows_;			// and the rows of their sweep
+};
+
 template <typename T>
-class Space
+class Solver
 {
 public:
-	Space(size_t rows_, size_t cols_) :
-		m_Rows_(rows_), m_Cols_(cols_)
+	// profile_ is an optional QueryProfile of seq2_, shared by the solvers of one query.
+	// memory_ only applies to RegionFull, the restricted regions always keep rows and packed traces.
+	// with wavefront_, RegionFull pairs above s_WavefrontCells_ cells are aligned in tiles on its threads, with the same result.
+	// workspace_ is shared by the solvers of one thread, one after the other. without it the solver has its own.
+	// the sequences are not copied, the caller keeps them alive like the rest.
+	Solver(const Sequence& seq1_, const Sequence& seq2_, const BloSum62<T>& blosum62_, eMemory memory_ = eMemory::MemoryAuto, const QueryProfile<T>* profile_ = nullptr, const Region& region_ = Region(), Wavefront* wavefront_ = nullptr, Workspace<T>* workspace_ = nullptr) :
+//	Solver(const Sequence& seq1_, const Sequence& seq2_) :
+		m_BloSum62_(blosum62_), m_Seq1_(seq1_), m_Seq2_(seq2_),
+//		m_Seq1_(seq1_), m_Seq2_(seq2_),
+		m_Seq1Len_(seq1_.GetSequence().length()), m_Seq2Len_(seq2_.GetSequence().length()), m_Region_(region_),
+		m_Linear_(region_.kind == eRegion::RegionFull && UseLinear(memory_, m_Seq1Len_, m_Seq2Len_)), m_Limited_(false), m_Cells_(0),
+		m_EndI_(m_Seq1Len_), m_EndJ_(m_Seq2Len_), m_EndA_((T)NEGINF), m_EndB_((T)NEGINF), m_EndC_((T)NEGINF),
+		m_Workspace_(workspace_), m_Profile_(profile_), m_Wavefront_(wavefront_)
 	{
-		// allocate value space.
-		m_Value_ = new T*[m_Rows_];
-		for(size_t i = 0; i < m_Rows_; ++i)
+		if(m_Workspace_ == nullptr)
 		{
-			m_Value_[i] = new T[m_Cols_];
-			memset(m_Value_[i], (T)0, sizeof(T)*m_Cols_);
+			m_OwnWorkspace_.reset(new Workspace<T>());
+			m_Workspace_ = m_OwnWorkspace_.get();
 		}
-		// allocate trace space.
-		m_Trace_ = new eTrace*[m_Rows_];
-		for(size_t i = 0; i < m_Rows_; ++i)
+
+		// residue codes, and the profile the kernels read the scores from.
+		BloSum62<T>::Encode(m_Seq1_.GetSequence(), m_Workspace_->m_Code1_);
+		BloSum62<T>::Encode(m_Seq2_.GetSequence(), m_Workspace_->m_Code2_);
+		if(m_Profile_ == nullptr)
 		{
-			m_Trace_[i] = new eTrace[m_Cols_];
-			memset(m_Trace_[i], (int)eTrace::None, sizeof(eTrace)*m_Cols_);
+			m_Workspace_->m_Profile_.Assign(m_BloSum62_, m_Workspace_->m_Code2_.data(), m_Seq2Len_);
+			m_Profile_ = &m_Workspace_->m_Profile_;
 		}
+		assert(m_Profile_->GetLength() == m_Seq2Len_);
+
+		// the rows of the sweeps, see WorkRow().
+		Workspace<T>::Fit(m_Workspace_->m_Rows_, 4*3*(m_Seq2Len_ + 1));
 	}
-	Space(size_t rows_, size_t cols_, const std::initializer_list<T>& values_, const std::initializer_list<eTrace>& traces_) :
-		m_Rows_(rows_), m_Cols_(cols_)
-	{
-		//
-		assert((values_.size() == rows_*cols_) && (traces_.size() == rows_*cols_));
-		// allocate value space.
-		m_Value_ = new T*[m_Rows_];
-		for(size_t i = 0; i < m_Rows_; ++i)
-		{
-			m_Value_[i] = new T[m_Cols_];
-			memcpy(m_Value_[i], values_.begin() + m_Cols_*i, sizeof(T)*m_Cols_);
-		}
-		// allocate trace space.
-		m_Trace_ = new eTrace*[m_Rows_];
-		for(size_t i = 0; i < m_Rows_; ++i)
+
+	// whether the traces of the whole rectangle are skipped for this pair.
+	inline bool IsLinear() const
+	{
+		return m_Linear_;
+	}
+	// after Update(): whether the band or the X-drop may have cut off a better alignment.
+	// the path runs along the edge of the region, the best cell of a row lies on its edge, or with X-drop
+	// the last cell was dropped and the result only aligns the prefixes up to the best cell. rerun such pairs with RegionFull.
+	// this is a heuristic for both regions and it can miss: a better path may leave the band and come back
+	// while the band's own path and row maxima stay clear of its edges. a bound that never misses would need
+	// the best score from every edge cell to the end, which costs as much as the full rectangle.
+	// a pair that is not limited is exact only for RegionFull.
+	inline bool IsLimited() const
+	{
+		return m_Limited_;
+	}
+	// after Update() or Score(): the cells computed, row 0 and column 0 included. (m+1)*(n+1) for RegionFull,
+	// the cells of the region for the others. the linear traceback computes its blocks again on top of these.
+	inline size_t GetCells() const
+	{
+		return m_Cells_;
+	}
+
+	T Update()
+	{
+		if(m_Region_.kind != eRegion::RegionFull)
+			return UpdateRegion();
+
+		// rows 1 ... m from row 0, a large pair in tiles on the wavefront threads.
+		// full memory keeps the packed traces of every row for Construct(), linear memory none.
+		const size_t cols = m_Seq2Len_ + 1;
+		m_Cells_ = (m_Seq1Len_ + 1)*cols;
+		Row top = WorkRow(0), last = WorkRow(3);
+		FirstRow(top, cols);
+		unsigned char* trace = m_Linear_ ? nullptr : Workspace<T>::Fit(m_Workspace_->m_Trace_, m_Seq1Len_*cols);
+		if(m_Seq1Len_ > 0)
+			Sweep(top, 0, &m_Seq1Len_, 1, cols, last.a, trace);
+		else
+			last = top;
+
+		// keep the last cell for Construct().
+		m_EndA_ = last.a[m_Seq2Len_];
+		m_EndB_ = last.b[m_Seq2Len_];
+		m_EndC_ = last.c[m_Seq2Len_];
+		eTrace start = eTrace::None;
+		return Select(m_EndA_, m_EndB_, m_EndC_, start);
+	}
+
+	// score-only alignment through the striped SIMD kernels, no traces are kept.
+	// Construct() still needs Update() to be called first. a restricted region is scored by Update().
+	T Score()
+	{
+		int score = 0;
+		if(m_Region_.kind == eRegion::RegionFull && ScoreStriped(m_BloSum62_, score))
 		{
-			m_Trace_[i] = new eTrace[m_Cols_];
-			memcpy(m_Trace_[i], traces_.begin() + m_Cols_*i, sizeof(eTrace)*m_Cols_);
+			m_Cells_ = (m_Seq1Len_ + 1)*(m_Seq2Len_ + 1);
+			return (T)score;
 		}
+		// no vector unit, unknown residue or overflow in 16-bit lanes: the scalar path.
+		return Update();
 	}
-	~Space()
+
+	// the best local alignment (Smith-Waterman with the same gaps: a path may start at any cell with 0): its score,
+	// and the residues [begin1_, end1_) of seq1 and [begin2_, end2_) of seq2 it aligns, all 0 for no positive score.
+	// its end is the first best cell row by row. the global alignment of the two spans scores the same, so a Solver
+	// of the spans gives the local alignment itself, in any memory mode. scalar, two rows of the workspace.
+	T Locate(size_t& begin1_, size_t& end1_, size_t& begin2_, size_t& end2_) const
 	{
-		if(m_Value_ != nullptr)
+		const size_t cols = m_Seq2Len_ + 1;
+		Row prev = WorkRow(1), cur = WorkRow(2);
+		// the start of the path into A, B and C of a cell, as the cell before its first pair: i*cols + j.
+		size_t* starts = Workspace<T>::Fit(m_Workspace_->m_Starts_, 6*cols);
+		size_t* prevStart[4] = { nullptr, starts, starts + cols, starts + 2*cols };
+		size_t* curStart[4] = { nullptr, starts + 3*cols, starts + 4*cols, starts + 5*cols };
+
+		// row 0 and column 0 are -inf, a local path starts with a pair.
+		for(size_t j = 0; j < cols; ++j)
+			prev.a[j] = prev.b[j] = prev.c[j] = (T)NEGINF;
+		T best = (T)0;
+		size_t bestStart = 0;
+		begin1_ = end1_ = begin2_ = end2_ = 0;
+		for(size_t i = 1; i <= m_Seq1Len_; ++i)
 		{
-			for(size_t i = 0; i < m_Rows_; ++i)
+			const T* profile = m_Profile_->GetRow(m_Workspace_->m_Code1_[i - 1]);
+			cur.a[0] = cur.b[0] = cur.c[0] = (T)NEGINF;
+			eTrace trace = eTrace::None;
+			for(size_t j = 1; j < cols; ++j)
 			{
-				delete[] m_Value_[i];
+				// a pair goes on from the path diagonal of it while that one is above 0, or starts a new path.
+				T diag = Select(prev.a[j - 1], prev.b[j - 1], prev.c[j - 1], trace);
+				cur.a[j] = profile[j - 1] + ((diag > (T)0) ? diag : (T)0);
+				curStart[eTrace::FromA][j] = (diag > (T)0) ? prevStart[trace][j - 1] : (i - 1)*cols + j - 1;
+				cur.b[j] = Select(cur.a[j - 1] - (g_Wg + g_Ws), cur.b[j - 1] - g_Ws, cur.c[j - 1] - (g_Wg + g_Ws), trace);
+				curStart[eTrace::FromB][j] = curStart[trace][j - 1];
+				cur.c[j] = Select(prev.a[j] - (g_Wg + g_Ws), prev.b[j] - (g_Wg + g_Ws), prev.c[j] - g_Ws, trace);
+				curStart[eTrace::FromC][j] = prevStart[trace][j];
+
+				// a gap never ends a best path, it scores less than the pair before it.
+				if(cur.a[j] > best)
+				{
+					best = cur.a[j];
+					bestStart = curStart[eTrace::FromA][j];
+					end1_ = i;
+					end2_ = j;
+				}
 			}
-			delete[] m_Value_;
-			m_Value_ = nullptr;
+			std::swap(prev, cur);
+			std::swap_ranges(prevStart + 1, prevStart + 4, curStart + 1);
 		}
-		if(m_Trace_ != nullptr)
+
+		if(best > (T)0)
 		{
-			for(size_t i = 0; i < m_Rows_; ++i)
-			{
-				delete[] m_Trace_[i];
-			}
-			delete[] m_Trace_;
-			m_Trace_ = nullptr;
+			begin1_ = bestStart/cols;
+			begin2_ = bestStart%cols;
 		}
+		return best;
 	}
 
-	void PrintValueMatrix() const
+	SeqPair Construct() const
 	{
-		for(size_t i = 0; i < m_Rows_; ++i)
-		{
-			for(size_t j = 0; j < m_Cols_; ++j)
-			{
-				std::cout << m_Value_[i][j] << "\t";
-			}
-			std::cout << std::endl;
-		}
+		SeqPair result;
+		Construct(result);
+		return result;
 	}
-	void PrintTraceMatrix() const
+	// Construct() into result_, its strings keep their capacity from one pair to the next.
+	void Construct(SeqPair& result_) const
 	{
-		for(size_t i = 0; i < m_Rows_; ++i)
+		// the path is followed from the end, the workspace strings take it backwards and are reversed once.
+		std::string& resSeq1 = m_Workspace_->m_Res1_;
+		std::string& resSeq2 = m_Workspace_->m_Res2_;
+		resSeq1.clear();
+		resSeq2.clear();
+		if(resSeq1.capacity() < m_Seq1Len_ + m_Seq2Len_)
+		{
+			resSeq1.reserve(m_Seq1Len_ + m_Seq2Len_);
+			resSeq2.reserve(m_Seq1Len_ + m_Seq2Len_);
+		}
+
+		if(m_Region_.kind != eRegion::RegionFull)
+			TraceRegion(&resSeq1, &resSeq2);
+		else
 		{
-			for(size_t j = 0; j < m_Cols_; ++j)
+			// the start matrix: the max of the last cell, ties broken A, B, C.
+			Node node;
+			node.j = m_Seq2Len_;
+			Select(m_EndA_, m_EndB_, m_EndC_, node.state);
+
+			if(m_Linear_)
 			{
-				if(m_Trace_[i][j] == eTrace::None)
-					std::cout << "N\t";
-				else if(m_Trace_[i][j] == eTrace::FromA)
-					std::cout << "A\t";
-				else if(m_Trace_[i][j] == eTrace::FromB)
-					std::cout << "B\t";
-				else 
-					std::cout << "C\t";
+				Row top = WorkRow(0);
+				FirstRow(top, m_Seq2Len_ + 1);
+				node = TraceRows(0, 0, m_Seq1Len_, top, node, resSeq1, resSeq2);
+			}
+			else
+				node = TraceBlock(m_Workspace_->m_Trace_.data(), 0, m_Seq1Len_, m_Seq2Len_ + 1, node, resSeq1, resSeq2);
+
+			// row 0 is a leading gap in seq1.
+			const std::string& seq2 = m_Seq2_.GetSequence();
+			for(size_t j = node.j; j > 0; --j)
+			{
+				resSeq1.push_back('-');
+				resSeq2.push_back(seq2[j - 1]);
 			}
-			std::cout << std::endl;
 		}
+
+		result_.first.assign(resSeq1);
+		result_.second.assign(resSeq2);
+		std::reverse(result_.first.begin(), result_.first.end());
+		std::reverse(result_.second.begin(), result_.second.end());
 	}
 
-	inline size_t GetRows() const
+public:
+	static const T g_Wg;
+	static const T g_Ws;
+	// MemoryAuto switches to linear memory when (m+1)*(n+1) is larger than this.
+	static size_t s_LinearCells_;
+	// linear mode: rows*cols of a block traced back directly, and checkpoint rows per level.
+	static size_t s_LinearBlockCells_;
+	static size_t s_LinearFanout_;
+	// RegionBanded with width 0: diagonals beyond |n - m| on each side.
+	static size_t s_BandSlack_;
+	// with a Wavefront: rows*cols above which a sweep is split into tiles of s_TileRows_ x s_TileCols_ cells.
+	static size_t s_WavefrontCells_;
+	static size_t s_TileRows_;
+	static size_t s_TileCols_;
+
+private:
+	// one row of the three matrices, in a buffer of the workspace.
+	struct Row
 	{
-		return m_Rows_;
-	}
-	inline size_t GetCols() const
+		T* a;
+		T* b;
+		T* c;
+	};
+	// a cell on the alignment path and the matrix it is in.
+	struct Node
 	{
-		return m_Cols_;
-	}
-
-	inline void SetValue(const T& value_, size_t i_, size_t j_)
+		size_t j;
+		eTrace state;
+	};
+	// a sweep split into tiles, see Sweep().
+	struct Tiling
 	{
-		assert((0 <= i_ && i_ < m_Rows_) && (0 <= j_ && j_ < m_Cols_));
-		m_Value_[i_][j_] = value_;
+		size_t r0, cols, count;
+		const size_t* ends;
+		const size_t* bands;		// row band b is the rows (bands[b], bands[b + 1]]
+		const size_t* marks;		// band b ends at row ends[marks[b]], count when it ends at none
+		const size_t* sides;		// where the side of band b starts
+		Row edge, side;
+		T* scratch;					// two rows of s_TileCols_ + 1 cells per column of tiles
+		T* out;
+		unsigned char* trace;
+	};
+
+	static bool UseLinear(eMemory memory_, size_t seq1Len_, size_t seq2Len_)
+	{
+		if(memory_ == eMemory::MemoryAuto)
+			return (seq1Len_ + 1)*(seq2Len_ + 1) > s_LinearCells_;
+		return memory_ == eMemory::MemoryLinear;
 	}
-	inline void SetTrace(const eTrace& trace_, size_t i_, size_t j_)
+	// whether rows x cols cells are worth splitting into tiles.
+	inline bool UseWavefront(size_t rows, size_t cols) const
 	{
-		assert((0 <= i_ && i_ < m_Rows_) && (0 <= j_ && j_ < m_Cols_));
-		m_Trace_[i_][j_] = trace_;
+		return m_Wavefront_ != nullptr && m_Wavefront_->GetThreads() > 1 && rows > 0 && cols > 1 && rows*cols > s_WavefrontCells_;
 	}
-	inline T& GetValue(size_t i_, size_t j_) const
+	// the striped kernels score in integer lanes, other types take the scalar path.
+	template <typename U>
+	bool ScoreStriped(const BloSum62<U>&, int&) const
 	{
-		assert((0 <= i_ && i_ < m_Rows_) && (0 <= j_ && j_ < m_Cols_));
-		return m_Value_[i_][j_];
+		return false;
 	}
-	inline eTrace& GetTrace(size_t i_, size_t j_) const
+	bool ScoreStriped(const BloSum62<int>& blosum62_, int& score_) const
 	{
-		assert((0 <= i_ && i_ < m_Rows_) && (0 <= j_ && j_ < m_Cols_));
-		return m_Trace_[i_][j_];
+		const std::vector<unsigned char>& code1 = m_Workspace_->m_Code1_;
+		const std::vector<unsigned char>& code2 = m_Workspace_->m_Code2_;
+		StripedProfile& striped = m_Workspace_->m_Striped_;
+		striped.Assign(blosum62_.GetMatrix(), BloSum62<int>::s_Alphabet_, code2.data(), code2.size());
+		return StripedScore(striped, code1.data(), code1.size(), (int)g_Wg, (int)g_Ws, m_Workspace_->m_StripedRows_, score_);
 	}
 
-	inline T** GetValue() const
+	// the row at base, its a, b and c stride apart.
+	static inline Row MakeRow(T* base, size_t stride)
 	{
-		return m_Value_;
+		Row row = { base, base + stride, base + 2*stride };
+		return row;
 	}
-	inline eTrace** GetTrace() const
+	// the columns [first, last) of from into to.
+	static inline void CopyRow(const Row& from, const Row& to, size_t first, size_t last)
 	{
-		return m_Trace_;
+		std::copy(from.a + first, from.a + last, to.a + first);
+		std::copy(from.b + first, from.b + last, to.b + first);
+		std::copy(from.c + first, from.c + last, to.c + first);
 	}
-	inline T**& GetValue()
+	// the rows of the workspace: 0 is row 0, 1 and 2 roll through a sweep, 3 is the last row.
+	inline Row WorkRow(size_t slot) const
 	{
-		return m_Value_;
+		return MakeRow(m_Workspace_->m_Rows_.data() + slot*3*(m_Seq2Len_ + 1), m_Seq2Len_ + 1);
 	}
-	inline eTrace**& GetTrace()
+
+	// the max of three candidates, ties broken A, B, C.
+	static inline T Select(const T& valA, const T& valB, const T& valC, eTrace& trace)
 	{
-		return m_Trace_;
+		if((valA >= valB) && (valA >= valC))
+		{
+			trace = eTrace::FromA;
+			return valA;
+		}
+		else if((valB >= valA) && (valB >= valC))
+		{
+			trace = eTrace::FromB;
+			return valB;
+		}
+		trace = eTrace::FromC;
+		return valC;
 	}
 
-private:
-	size_t m_Rows_, m_Cols_;
-	T **m_Value_;
-	eTrace **m_Trace_;
-};
-
-template <typename T>
-class Solver
-{
-public:
-	Solver(const Sequence& seq1_, const Sequence& seq2_, const BloSum62<T>& blosum62_) :
-//	Solver(const Sequence& seq1_, const Sequence& seq2_) :
-		m_Seq1_(seq1_), m_Seq2_(seq2_), m_BloSum62_(blosum62_),
-//		m_Seq1_(seq1_), m_Seq2_(seq2_),
-		m_Seq1Len_(seq1_.GetSequence().length()), m_Seq2Len_(seq2_.GetSequence().length()),
-		m_MtxA_(m_Seq1Len_ + 1, m_Seq2Len_ + 1), m_MtxB_(m_Seq1Len_ + 1, m_Seq2Len_ + 1), m_MtxC_(m_Seq1Len_ + 1, m_Seq2Len_ + 1)
+	// row 0 of A, B and C over the columns [0, cols): A[0][0] = 0, a leading gap B[0][k] = -(Wg + k*Ws), -inf elsewhere.
+	void FirstRow(const Row& row, size_t cols) const
 	{
-		InitializeSpace();
+		row.a[0] = (T)0;
+		row.b[0] = (T)NEGINF;
+		row.c[0] = (T)NEGINF;
+		for(size_t k = 1; k < cols; ++k)
+		{
+			row.a[k] = (T)NEGINF;
+			row.b[k] = (T)(-(g_Wg + ((T)k)*g_Ws));
+			row.c[k] = (T)NEGINF;
+		}
 	}
 
-	inline Space<T>& GetSpaceA()
+	// row i of A, B and C from row i - 1 over the columns [0, cols).
+	// when trace is given, the three traces of each cell are packed into one byte: A | B << 2 | C << 4.
+	void ForwardRow(const Row& prev, const Row& cur, size_t i, size_t cols, unsigned char* trace) const
 	{
-		return m_MtxA_;
+		FirstColumn(cur, i, 0, trace);
+		ForwardCells<false>(prev, cur, m_Profile_->GetRow(m_Workspace_->m_Code1_[i - 1]), 1, cols - 1, (trace != nullptr) ? trace + 1 : nullptr, (T)NEGINF);
 	}
-	inline Space<T>& GetSpaceB()
+
+	// column 0 of row i, stored at cur[k]: a leading gap C[i][0] = -(Wg + i*Ws) traced back to A[0][0], -inf in A and B.
+	void FirstColumn(const Row& cur, size_t i, size_t k, unsigned char* trace) const
 	{
-		return m_MtxB_;
+		cur.a[k] = (T)NEGINF;
+		cur.b[k] = (T)NEGINF;
+		cur.c[k] = (T)(-(g_Wg + ((T)i)*g_Ws));
+		if(trace != nullptr)
+			trace[0] = (unsigned char)(((i == 1) ? eTrace::FromA : eTrace::FromC) << 4);
 	}
-	inline Space<T>& GetSpaceC()
+
+	// the columns [first, last] of a row from the row above, profile is the row of its seq1 residue.
+	// trace[0] is the packed trace of column first. with Drop a cell below floor in all three matrices is set to -inf.
+	template <bool Drop>
+	void ForwardCells(const Row& prev, const Row& cur, const T* profile, size_t first, size_t last, unsigned char* trace, T floor) const
 	{
-		return m_MtxC_;
+		eTrace traceA = eTrace::None, traceB = eTrace::None, traceC = eTrace::None;
+		for(size_t j = first; j <= last; ++j)
+		{
+			T sigma = profile[j - 1];
+			cur.a[j] = Select(sigma + prev.a[j - 1], sigma + prev.b[j - 1], sigma + prev.c[j - 1], traceA);
+			cur.b[j] = Select(cur.a[j - 1] - (g_Wg + g_Ws), cur.b[j - 1] - g_Ws, cur.c[j - 1] - (g_Wg + g_Ws), traceB);
+			cur.c[j] = Select(prev.a[j] - (g_Wg + g_Ws), prev.b[j] - (g_Wg + g_Ws), prev.c[j] - g_Ws, traceC);
+			if(trace != nullptr)
+				trace[j - first] = (unsigned char)(traceA | (traceB << 2) | (traceC << 4));
+			if(Drop && cur.a[j] < floor && cur.b[j] < floor && cur.c[j] < floor)
+				cur.a[j] = cur.b[j] = cur.c[j] = (T)NEGINF;
+		}
 	}
 
-	T Update()
+	// rows (r0, ends[count - 1]] over the columns [0, cols) from the row top.
+	// when out is given, row ends[k] is copied to out + 3*cols*k (a, b and c cols apart).
+	// with trace, the packed traces of row i go to trace + (i - r0 - 1)*cols, see ForwardRow().
+	// a large sweep is split into tiles on the wavefront threads: a tile only gets the bottom row of the tile above
+	// and the right column of the tile left of it, and leaves its own for the next ones.
+	void Sweep(const Row& top, size_t r0, const size_t* ends, size_t count, size_t cols, T* out, unsigned char* trace) const
 	{
-		// get these two sequences.
-		std::string seq1 = m_Seq1_.GetSequence(), seq2 = m_Seq2_.GetSequence();
-		// update matrix A, B and C.
-		T valA = (T)0, valB = (T)0, valC = (T)0;
-		for(size_t i = 1; i <= m_Seq1Len_; ++i)
+		if(!UseWavefront(ends[count - 1] - r0, cols))
 		{
-			for(size_t j = 1; j <= m_Seq2Len_; ++j)
+			Row prev = WorkRow(1), cur = WorkRow(2);
+			CopyRow(top, prev, 0, cols);
+			for(size_t i = r0 + 1, k = 0; i <= ends[count - 1]; ++i)
 			{
-				/// update the matrix A
-				T sigma = m_BloSum62_.GetValue(seq1[i - 1], seq2[j - 1]);
-				valA = sigma + m_MtxA_.GetValue(i - 1, j - 1);
-				valB = sigma + m_MtxB_.GetValue(i - 1, j - 1);
-				valC = sigma + m_MtxC_.GetValue(i - 1, j - 1);
-				if((valA >= valB) && (valA >= valC))			// valA is the max value.
-				{
-					m_MtxA_.SetValue(valA, i, j);
-					m_MtxA_.SetTrace(eTrace::FromA, i, j);
-				} 
-				else if((valB >= valA) && (valB >= valC))		// valB is the max value.
-				{
-					m_MtxA_.SetValue(valB, i, j);
-					m_MtxA_.SetTrace(eTrace::FromB, i, j);
-				} else if((valC >= valA) && (valC >= valB))		// valC is the max value.
-				{
-					m_MtxA_.SetValue(valC, i, j);
-					m_MtxA_.SetTrace(eTrace::FromC, i, j);
-				}
-
-				/// update the matrix B
-				valA = m_MtxA_.GetValue(i, j - 1) - (g_Wg + g_Ws); 
-				valB = m_MtxB_.GetValue(i, j - 1) - g_Ws; 
-				valC = m_MtxC_.GetValue(i, j - 1) - (g_Wg + g_Ws);
-				if((valA >= valB) && (valA >= valC))
+				ForwardRow(prev, cur, i, cols, (trace != nullptr) ? trace + (i - r0 - 1)*cols : nullptr);
+				std::swap(prev, cur);
+				if(i == ends[k])
 				{
-					m_MtxB_.SetValue(valA, i, j);
-					m_MtxB_.SetTrace(eTrace::FromA, i, j);
-				} else if((valB >= valA) && (valB >= valC))	
-				{
-					m_MtxB_.SetValue(valB, i, j);
-					m_MtxB_.SetTrace(eTrace::FromB, i, j);
-				} else if((valC >= valA) && (valC >= valB))
-				{
-					m_MtxB_.SetValue(valC, i, j);
-					m_MtxB_.SetTrace(eTrace::FromC, i, j);
+					if(out != nullptr)
+						CopyRow(prev, MakeRow(out + 3*cols*k, cols), 0, cols);
+					++k;
 				}
+			}
+			return;
+		}
 
-				/// update the matrix C
-				valA = m_MtxA_.GetValue(i - 1, j) - (g_Wg + g_Ws);
-				valB = m_MtxB_.GetValue(i - 1, j) - (g_Wg + g_Ws);
-				valC = m_MtxC_.GetValue(i - 1, j) - g_Ws;
-				if((valA >= valB) && (valA >= valC))
-				{
-					m_MtxC_.SetValue(valA, i, j);
-					m_MtxC_.SetTrace(eTrace::FromA, i, j);
-				} else if((valB >= valA) && (valB >= valC))
-				{
-					m_MtxC_.SetValue(valB, i, j);
-					m_MtxC_.SetTrace(eTrace::FromB, i, j);
-				} else if((valC >= valA) && (valC >= valB))
+		// row bands end at every row of ends.
+		std::vector<size_t>& bands = m_Workspace_->m_Bands_;
+		std::vector<size_t>& marks = m_Workspace_->m_Marks_;
+		std::vector<size_t>& sides = m_Workspace_->m_Sides_;
+		bands.assign(1, r0);
+		marks.clear();
+		for(size_t k = 0; k < count; ++k)
+		{
+			while(bands.back() < ends[k])
+			{
+				bands.push_back(std::min(bands.back() + s_TileRows_, ends[k]));
+				marks.push_back((bands.back() == ends[k]) ? k : count);
+			}
+		}
+		const size_t tileRows = bands.size() - 1, tileCols = (cols - 1 + s_TileCols_ - 1)/s_TileCols_;
+		sides.assign(1, 0);
+		for(size_t b = 0; b < tileRows; ++b)
+			sides.push_back(sides[b] + bands[b + 1] - bands[b] + 1);
+
+		// edge: the bottom row of the last tile of each column band, top to begin with.
+		// side: the right column of the last tile of each row band, rows bands[b] ... bands[b + 1], column 0 to begin with.
+		T* tiles = Workspace<T>::Fit(m_Workspace_->m_Tiles_, 3*cols + 3*sides.back() + 6*(s_TileCols_ + 1)*tileCols);
+		Tiling tiling;
+		tiling.r0 = r0;
+		tiling.cols = cols;
+		tiling.count = count;
+		tiling.ends = ends;
+		tiling.bands = bands.data();
+		tiling.marks = marks.data();
+		tiling.sides = sides.data();
+		tiling.edge = MakeRow(tiles, cols);
+		tiling.side = MakeRow(tiles + 3*cols, sides.back());
+		tiling.scratch = tiles + 3*cols + 3*sides.back();
+		tiling.out = out;
+		tiling.trace = trace;
+
+		CopyRow(top, tiling.edge, 0, cols);
+		for(size_t b = 0; b < tileRows; ++b)
+		{
+			for(size_t i = bands[b]; i <= bands[b + 1]; ++i)
+			{
+				if(i == r0)
 				{
-					m_MtxC_.SetValue(valC, i, j);
-					m_MtxC_.SetTrace(eTrace::FromC, i, j);
+					tiling.side.a[sides[b]] = top.a[0];
+					tiling.side.b[sides[b]] = top.b[0];
+					tiling.side.c[sides[b]] = top.c[0];
 				}
+				else
+					FirstColumn(tiling.side, i, sides[b] + i - bands[b], nullptr);
 			}
 		}
+		if(out != nullptr)
+		{
+			for(size_t k = 0; k < count; ++k)
+				FirstColumn(MakeRow(out + 3*cols*k, cols), ends[k], 0, nullptr);
+		}
 
-		// get the last score of each value matrix.
-		valA = m_MtxA_.GetValue(m_Seq1Len_, m_Seq2Len_);
-		valB = m_MtxB_.GetValue(m_Seq1Len_, m_Seq2Len_);
-		valC = m_MtxB_.GetValue(m_Seq1Len_, m_Seq2Len_);
-		// return the max score.
-		return (valA >= valB) ? ((valA >= valC) ? valA : valC) : ((valB >= valC) ? valB : valC);
+		// the tiling by reference only, so the tile function needs no allocation.
+		const Tiling& shared = tiling;
+		m_Wavefront_->Run(tileRows, tileCols, [this, &shared](size_t b, size_t t) {
+			SweepTile(shared, b, t);
+		});
 	}
 
-	SeqPair Construct() const
+	// the tile of row band b and column band t of a sweep.
+	void SweepTile(const Tiling& tiling, size_t b, size_t t) const
 	{
-		std::string origSeq1 = m_Seq1_.GetSequence(), origSeq2 = m_Seq2_.GetSequence();
-		std::string resSeq1 = "", resSeq2 = "";
-
-		// initialize the current trace & some other parameters.
-		T valA = (T)0, valB = (T)0, valC = (T)0;
-		eTrace current = eTrace::None;
-		size_t i = m_Seq1Len_, j = m_Seq2Len_;
+		const size_t c0 = t*s_TileCols_, width = std::min(c0 + s_TileCols_, tiling.cols - 1) - c0, s0 = tiling.sides[b];
+		const Row& edge = tiling.edge;
+		const Row& side = tiling.side;
+
+		// column 0 of the tile is the right column of the tile before, row 0 its bottom row.
+		// the tiles of a column band run one after the other, so they share two rows.
+		T* scratch = tiling.scratch + 6*(s_TileCols_ + 1)*t;
+		Row prev = MakeRow(scratch, s_TileCols_ + 1), cur = MakeRow(scratch + 3*(s_TileCols_ + 1), s_TileCols_ + 1);
+		prev.a[0] = side.a[s0];
+		prev.b[0] = side.b[s0];
+		prev.c[0] = side.c[s0];
+		std::copy(edge.a + c0 + 1, edge.a + c0 + width + 1, prev.a + 1);
+		std::copy(edge.b + c0 + 1, edge.b + c0 + width + 1, prev.b + 1);
+		std::copy(edge.c + c0 + 1, edge.c + c0 + width + 1, prev.c + 1);
+		side.a[s0] = prev.a[width];
+		side.b[s0] = prev.b[width];
+		side.c[s0] = prev.c[width];
+
+		for(size_t i = tiling.bands[b] + 1; i <= tiling.bands[b + 1]; ++i)
+		{
+			const size_t s = s0 + i - tiling.bands[b];
+			unsigned char* rowTrace = (tiling.trace != nullptr) ? tiling.trace + (i - tiling.r0 - 1)*tiling.cols + c0 : nullptr;
+			if(c0 == 0 && rowTrace != nullptr)
+				FirstColumn(cur, i, 0, rowTrace);
+			cur.a[0] = side.a[s];
+			cur.b[0] = side.b[s];
+			cur.c[0] = side.c[s];
+			ForwardCells<false>(prev, cur, m_Profile_->GetRow(m_Workspace_->m_Code1_[i - 1]) + c0, 1, width, (rowTrace != nullptr) ? rowTrace + 1 : nullptr, (T)NEGINF);
+			side.a[s] = cur.a[width];
+			side.b[s] = cur.b[width];
+			side.c[s] = cur.c[width];
+			std::swap(prev, cur);
+		}
 
-		// get the value of each matrix.
-		valA = m_MtxA_.GetValue(i, j); valB = m_MtxB_.GetValue(i, j); valC = m_MtxC_.GetValue(i, j);
+		std::copy(prev.a + 1, prev.a + width + 1, edge.a + c0 + 1);
+		std::copy(prev.b + 1, prev.b + width + 1, edge.b + c0 + 1);
+		std::copy(prev.c + 1, prev.c + width + 1, edge.c + c0 + 1);
+		if(tiling.out != nullptr && tiling.marks[b] < tiling.count)
+		{
+			Row row = MakeRow(tiling.out + 3*tiling.cols*tiling.marks[b], tiling.cols);
+			std::copy(prev.a + 1, prev.a + width + 1, row.a + c0 + 1);
+			std::copy(prev.b + 1, prev.b + width + 1, row.b + c0 + 1);
+			std::copy(prev.c + 1, prev.c + width + 1, row.c + c0 + 1);
+		}
+	}
 
-		// get the start matrix.
-		if((valA >= valB) && (valA >= valC))
-			current = eTrace::FromA;
-		else if((valB >= valA) && (valB >= valC))
-			current = eTrace::FromB;
-		else if((valC >= valA) && (valC >= valB))
-			current = eTrace::FromC;
+	// follow the packed traces of the rows (r0, r1] from (r1, node.j) in matrix node.state until the path reaches row r0.
+	// trace holds row i at (i - r0 - 1)*cols, the result strings are built backwards.
+	Node TraceBlock(const unsigned char* trace, size_t r0, size_t r1, size_t cols, Node node, std::string& resSeq1, std::string& resSeq2) const
+	{
+		const std::string& seq1 = m_Seq1_.GetSequence();
+		const std::string& seq2 = m_Seq2_.GetSequence();
 
-		// start trace back.
-		while((i > 0) || (j > 0))
+		size_t i = r1, j = node.j;
+		eTrace current = node.state;
+		while(i > r0)
 		{
+			unsigned char packed = trace[(i - r0 - 1)*cols + j];
 			if(current == eTrace::FromA)
 			{
-				// get the trace.
-				current = m_MtxA_.GetTrace(i, j);
-				// trace back.
-				resSeq1 = std::string(1, origSeq1[i - 1]) + resSeq1;	// there is a offset 1 between origSeq1 & (A or B or C).
-				resSeq2 = std::string(1, origSeq2[j - 1]) + resSeq2;
+				current = (eTrace)(packed & 3);
+				resSeq1.push_back(seq1[i - 1]);
+				resSeq2.push_back(seq2[j - 1]);
 				--i; --j;
-			} 
+			}
 			else if(current == eTrace::FromB)
 			{
-				// get the trace.
-				current = m_MtxB_.GetTrace(i, j);
-				// trace back.
-				resSeq1 = "-" + resSeq1;	
-				resSeq2 = std::string(1, origSeq2[j - 1]) + resSeq2;	// there is a offset 1 between origSeq1 & (A or B or C).
+				current = (eTrace)((packed >> 2) & 3);
+				resSeq1.push_back('-');
+				resSeq2.push_back(seq2[j - 1]);
 				--j;
-			} 
+			}
 			else if(current == eTrace::FromC)
 			{
-				// get the trace.
-				current = m_MtxC_.GetTrace(i, j);
-				// trace back.
-				resSeq1 = std::string(1, origSeq1[i - 1]) + resSeq1;	// there is a offset 1 between origSeq1 & (A or B or C).
-				resSeq2 = "-" + resSeq2;
+				current = (eTrace)((packed >> 4) & 3);
+				resSeq1.push_back(seq1[i - 1]);
+				resSeq2.push_back('-');
 				--i;
 			}
-			// debug
-//			std::cout << "[" << i << ", " << j << "]" << std::endl;
+			else
+			{
+				// only the -inf borders have no trace, a path never gets there.
+				assert(false);
+				break;
+			}
+		}
+		node.j = j;
+		node.state = current;
+		return node;
+	}
+
+	// trace the path back from (r1, node.j) in matrix node.state until it reaches row r0, top is row r0.
+	// the result strings are built backwards. the rows are split into s_LinearFanout_ parts at checkpoint rows,
+	// and the parts are traced from the bottom up, so the path is the one of the packed traces of the whole rectangle.
+	// level is the depth of the recursion, each level keeps its checkpoints in the workspace.
+	Node TraceRows(size_t level, size_t r0, size_t r1, const Row& top, Node node, std::string& resSeq1, std::string& resSeq2) const
+	{
+		const size_t rows = r1 - r0, cols = node.j + 1;
+
+		// a block per wavefront thread, so a block still has tiles for all of them.
+		const size_t blockCells = s_LinearBlockCells_*((m_Wavefront_ != nullptr) ? m_Wavefront_->GetThreads() : 1);
+		if(rows <= 1 || rows*cols <= blockCells)
+		{
+			// small enough: keep the traces of the whole block.
+			unsigned char* trace = Workspace<T>::Fit(m_Workspace_->m_Trace_, rows*cols);
+			Sweep(top, r0, &r1, 1, cols, nullptr, trace);
+			return TraceBlock(trace, r0, r1, cols, node, resSeq1, resSeq2);
 		}
 
-		return SeqPair(resSeq1, resSeq2);
+		// checkpoint rows at the start of each part, part 0 starts at top.
+		std::vector<typename Workspace<T>::Level>& levels = m_Workspace_->m_Levels_;
+		if(levels.size() <= level)
+			levels.resize(level + 1);
+		const size_t parts = (rows < s_LinearFanout_) ? rows : s_LinearFanout_;
+		size_t* bounds = Workspace<T>::Fit(levels[level].bounds, parts + 1);
+		for(size_t p = 0; p <= parts; ++p)
+			bounds[p] = r0 + rows*p/parts;
+		T* marks = Workspace<T>::Fit(levels[level].marks, 3*cols*(parts - 1));
+		Sweep(top, r0, bounds + 1, parts - 1, cols, marks, nullptr);
+
+		// bottom part first, the path only gets shorter on the left.
+		for(size_t p = parts; p-- > 0; )
+			node = TraceRows(level + 1, bounds[p], bounds[p + 1], (p == 0) ? top : MakeRow(marks + 3*cols*(p - 1), cols), node, resSeq1, resSeq2);
+		return node;
 	}
 
-public:
-	static const T g_Wg;
-	static const T g_Ws;
+	static inline void Clear(const Row& row, size_t j)
+	{
+		row.a[j] = row.b[j] = row.c[j] = (T)NEGINF;
+	}
 
-private:
-	void InitializeSpace()
+	// the columns of row i in the band: the diagonals j - i at most width away from the centre n - m.
+	void BandColumns(size_t i, size_t width, size_t& lo, size_t& hi) const
 	{
-		T** ptrValue = nullptr;
+		const long long centre = (long long)i + (long long)m_Seq2Len_ - (long long)m_Seq1Len_;
+		lo = (centre > (long long)width) ? (size_t)(centre - (long long)width) : 0;
+		hi = (centre + (long long)width < (long long)m_Seq2Len_) ? (size_t)(centre + (long long)width) : m_Seq2Len_;
+	}
 
-		// initialize matrix A
-		ptrValue = m_MtxA_.GetValue();
+	// RegionBanded and RegionXDrop: the rows are computed over their columns [lo[i], hi[i]] only,
+	// and the packed traces of those cells (see ForwardRow()) are kept one row after the other.
+	T UpdateRegion()
+	{
+		const size_t cols = m_Seq2Len_ + 1;
+		const bool drop = (m_Region_.kind == eRegion::RegionXDrop);
+		// the band holds both corners, so the last cell is always reached.
+		const size_t diff = (m_Seq1Len_ > m_Seq2Len_) ? m_Seq1Len_ - m_Seq2Len_ : m_Seq2Len_ - m_Seq1Len_;
+		const size_t width = (m_Region_.width == 0) ? diff + s_BandSlack_ : std::max(m_Region_.width, diff);
+
+		std::vector<size_t>& rowLo = m_Workspace_->m_Lo_;
+		std::vector<size_t>& rowHi = m_Workspace_->m_Hi_;
+		std::vector<size_t>& rowOffset = m_Workspace_->m_Offset_;
+		std::vector<unsigned char>& regionTrace = m_Workspace_->m_Trace_;
+		rowLo.assign(m_Seq1Len_ + 1, 0);
+		rowHi.assign(m_Seq1Len_ + 1, 0);
+		rowOffset.assign(m_Seq1Len_ + 1, 0);
+		regionTrace.clear();
+		if(!drop)
+			regionTrace.reserve((m_Seq1Len_ + 1)*std::min(cols, 2*width + 1));
+
+		// row 0, a leading gap in seq1. X-drop keeps its columns down to -X.
+		Row prev = WorkRow(1), cur = WorkRow(2);
+		FirstRow(prev, cols);
+		T best = (T)0, floor = (T)NEGINF;
+		size_t lo = 0, hi = 0;
+		if(drop)
+		{
+			floor = best - (T)m_Region_.drop;
+			while(hi < m_Seq2Len_ && prev.b[hi + 1] >= floor)
+				++hi;
+		}
+		else
+			BandColumns(0, width, lo, hi);
+		rowHi[0] = hi;
+		regionTrace.resize(hi + 1, 0);
+		for(size_t j = 1; j <= hi; ++j)
+			regionTrace[j] = (unsigned char)(((j == 1) ? eTrace::FromA : eTrace::FromB) << 2);
+
+		// X-drop: the best cell so far, the end of the alignment if the last cell is dropped.
+		size_t bestI = 0, bestJ = 0;
+		T bestA = (T)0, bestB = (T)NEGINF, bestC = (T)NEGINF;
+
+		size_t plo = lo, phi = hi;
+		bool reached = true, pushed = false;
+		for(size_t i = 1; i <= m_Seq1Len_; ++i)
+		{
+			if(drop)
+			{
+				// below the live columns of the row above, one more to the right for the diagonal.
+				lo = plo;
+				hi = std::min(phi + 1, m_Seq2Len_);
+			}
+			else
+				BandColumns(i, width, lo, hi);
+
+			// the row above is -inf outside its columns, so is the cell left of the first column.
+			const size_t from = (lo > 0) ? lo - 1 : 0;
+			for(size_t j = from; j <= hi && j < plo; ++j)
+				Clear(prev, j);
+			for(size_t j = std::max(from, phi + 1); j <= hi; ++j)
+				Clear(prev, j);
+			if(lo > 0)
+				Clear(cur, lo - 1);
+
+			const size_t offset = regionTrace.size();
+			rowLo[i] = lo;
+			rowOffset[i] = offset;
+			regionTrace.resize(offset + hi - lo + 1);
+			size_t first = lo;
+			if(lo == 0)
+			{
+				FirstColumn(cur, i, 0, regionTrace.data() + offset);
+				if(drop && cur.c[0] < floor)
+					Clear(cur, 0);
+				first = 1;
+			}
 
-		ptrValue[0][0] = 0;							// A[0][0] = 0
-		for(size_t k = 1; k <= m_Seq1Len_; ++k)		// A[1 ... end][0] = -inf
-			ptrValue[k][0] = (T)NEGINF;
-		for(size_t k = 1; k <= m_Seq2Len_; ++k)		// A[0][1 ... end] = -inf
-			ptrValue[0][k] = (T)NEGINF;
+			const T* profile = m_Profile_->GetRow(m_Workspace_->m_Code1_[i - 1]);
+			if(drop)
+			{
+				ForwardCells<true>(prev, cur, profile, first, hi, regionTrace.data() + offset + first - lo, floor);
+				// the row goes on to the right while its cells stay above the floor, the row above is -inf there.
+				while(hi < m_Seq2Len_ && std::max(cur.a[hi], std::max(cur.b[hi], cur.c[hi])) >= floor)
+				{
+					++hi;
+					Clear(prev, hi);
+					regionTrace.push_back(0);
+					ForwardCells<true>(prev, cur, profile, hi, hi, &regionTrace.back(), floor);
+				}
+			}
+			else
+				ForwardCells<false>(prev, cur, profile, first, hi, regionTrace.data() + offset + first - lo, (T)NEGINF);
+			rowHi[i] = hi;
+
+			// the live columns of the row, its best cell and the best cell so far.
+			size_t liveLo = hi + 1, liveHi = 0;
+			T rowBest = (T)NEGINF;
+			for(size_t j = lo; j <= hi; ++j)
+			{
+				eTrace state = eTrace::None;
+				T value = Select(cur.a[j], cur.b[j], cur.c[j], state);
+				if(drop && value < floor)
+					continue;
+				if(liveLo > hi)
+					liveLo = j;
+				liveHi = j;
+				rowBest = std::max(rowBest, value);
+				if(drop && value > best)
+				{
+					best = value;
+					bestI = i; bestJ = j;
+					bestA = cur.a[j]; bestB = cur.b[j]; bestC = cur.c[j];
+				}
+			}
+			if(liveLo > hi || (i == m_Seq1Len_ && liveHi != m_Seq2Len_))
+			{
+				// every cell of the row is dropped, or the last one is.
+				reached = false;
+				break;
+			}
+			// the best cell of the row next to cells left out: the alignment is pushing out of the region.
+			eTrace state = eTrace::None;
+			if((liveLo > 0 && Select(cur.a[liveLo], cur.b[liveLo], cur.c[liveLo], state) >= rowBest) ||
+				(liveHi < m_Seq2Len_ && Select(cur.a[liveHi], cur.b[liveHi], cur.c[liveHi], state) >= rowBest))
+				pushed = true;
+
+			plo = liveLo;
+			phi = liveHi;
+			if(drop)
+				floor = best - (T)m_Region_.drop;
+			std::swap(prev, cur);
+		}
+		if(drop && m_Seq1Len_ == 0 && rowHi[0] != m_Seq2Len_)
+			reached = false;
 
-		// initialize matrix B
-		ptrValue = m_MtxB_.GetValue();
+		if(reached)
+		{
+			m_EndI_ = m_Seq1Len_;
+			m_EndJ_ = m_Seq2Len_;
+			m_EndA_ = prev.a[m_Seq2Len_];
+			m_EndB_ = prev.b[m_Seq2Len_];
+			m_EndC_ = prev.c[m_Seq2Len_];
+		}
+		else
+		{
+			m_EndI_ = bestI;
+			m_EndJ_ = bestJ;
+			m_EndA_ = bestA;
+			m_EndB_ = bestB;
+			m_EndC_ = bestC;
+		}
+		m_Limited_ = TraceRegion(nullptr, nullptr) || pushed || !reached;
+		// one packed trace per cell of the rows computed.
+		m_Cells_ = regionTrace.size();
 
-		for(size_t k = 0; k <= m_Seq1Len_; ++k)		// B[0 ... end][0] = -inf
-			ptrValue[k][0] = (T)NEGINF;
-		for(size_t k = 1; k <= m_Seq2Len_; ++k)		// B[0][1 ... end] = -(Wg + k*Ws)
-			ptrValue[0][k] = (T)(-(g_Wg + ((T)k)*g_Ws));
+		eTrace start = eTrace::None;
+		return Select(m_EndA_, m_EndB_, m_EndC_, start);
+	}
 
-		// initialize matrix C
-		ptrValue = m_MtxC_.GetValue();
+	// follow the packed traces of a restricted region from the end cell to (0, 0), the result strings are built backwards when given.
+	// returns whether the path touches an edge of the region that is not an edge of the rectangle.
+	bool TraceRegion(std::string* resSeq1, std::string* resSeq2) const
+	{
+		const std::string& seq1 = m_Seq1_.GetSequence();
+		const std::string& seq2 = m_Seq2_.GetSequence();
+		const std::vector<size_t>& rowLo = m_Workspace_->m_Lo_;
+		const std::vector<size_t>& rowHi = m_Workspace_->m_Hi_;
+		const std::vector<size_t>& rowOffset = m_Workspace_->m_Offset_;
+		const std::vector<unsigned char>& regionTrace = m_Workspace_->m_Trace_;
+
+		size_t i = m_EndI_, j = m_EndJ_;
+		eTrace current = eTrace::None;
+		Select(m_EndA_, m_EndB_, m_EndC_, current);
+		bool edge = false;
+		while((i > 0) || (j > 0))
+		{
+			assert((rowLo[i] <= j) && (j <= rowHi[i]));
+			if((j == rowLo[i] && j > 0) || (j == rowHi[i] && j < m_Seq2Len_))
+				edge = true;
 
-		for(size_t k = 1; k <= m_Seq1Len_; ++k)		// B[1 ... end][0] = -(Wg + k*Ws)
-			ptrValue[k][0] = (T)(-(g_Wg + ((T)k)*g_Ws));
-		for(size_t k = 0; k <= m_Seq2Len_; ++k)		// B[0 ... end][0] = -inf
-			ptrValue[0][k] = (T)NEGINF;
+			unsigned char packed = regionTrace[rowOffset[i] + j - rowLo[i]];
+			if(current == eTrace::FromA)
+			{
+				current = (eTrace)(packed & 3);
+				if(resSeq1 != nullptr)
+				{
+					resSeq1->push_back(seq1[i - 1]);
+					resSeq2->push_back(seq2[j - 1]);
+				}
+				--i; --j;
+			}
+			else if(current == eTrace::FromB)
+			{
+				current = (eTrace)((packed >> 2) & 3);
+				if(resSeq1 != nullptr)
+				{
+					resSeq1->push_back('-');
+					resSeq2->push_back(seq2[j - 1]);
+				}
+				--j;
+			}
+			else if(current == eTrace::FromC)
+			{
+				current = (eTrace)((packed >> 4) & 3);
+				if(resSeq1 != nullptr)
+				{
+					resSeq1->push_back(seq1[i - 1]);
+					resSeq2->push_back('-');
+				}
+				--i;
+			}
+			else
+			{
+				// only -inf cells have no trace, a path never gets there.
+				assert(false);
+				break;
+			}
+		}
+		return edge;
 	}
 
 private:
-	BloSum62<T> m_BloSum62_;
-	Sequence m_Seq1_, m_Seq2_;
+	const BloSum62<T>& m_BloSum62_;	// shared, the caller keeps it alive
+	const Sequence& m_Seq1_;
+	const Sequence& m_Seq2_;
 	size_t m_Seq1Len_, m_Seq2Len_;
-
-	Space<T> m_MtxA_;
-	Space<T> m_MtxB_;
-	Space<T> m_MtxC_;
+	Region m_Region_;
+	bool m_Linear_;
+	bool m_Limited_;
+	size_t m_Cells_;
+	// the cell the traceback starts from, (m, n) unless X-drop dropped it.
+	size_t m_EndI_, m_EndJ_;
+	T m_EndA_, m_EndB_, m_EndC_;
+
+	std::unique_ptr<Workspace<T>> m_OwnWorkspace_;
+	Workspace<T>* m_Workspace_;
+	const QueryProfile<T>* m_Profile_;
+	Wavefront* m_Wavefront_;		// shared, may be nullptr
 };
 
 template <typename T>
@@ -371,4 +937,25 @@ const T Solver<T>::g_Wg = 10;
 template <typename T>
 const T Solver<T>::g_Ws = 2;
 
+template <typename T>
+size_t Solver<T>::s_LinearCells_ = (size_t)1 << 26;
+
+template <typename T>
+size_t Solver<T>::s_LinearBlockCells_ = (size_t)1 << 22;
+
+template <typename T>
+size_t Solver<T>::s_LinearFanout_ = 16;
+
+template <typename T>
+size_t Solver<T>::s_BandSlack_ = 32;
+
+template <typename T>
+size_t Solver<T>::s_WavefrontCells_ = (size_t)1 << 20;
+
+template <typename T>
+size_t Solver<T>::s_TileRows_ = 128;
+
+template <typename T>
+size_t Solver<T>::s_TileCols_ = 512;
+
 #endif	// __SOLVER_HXX__
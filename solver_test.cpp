@@ -0,0 +1,258 @@
+#include <random>
+#include <algorithm>
+
+#include "common.h"
+#include "blosum62.hxx"
+#include "solver.hxx"
+#include "striped.h"
+#include "wavefront.h"
+
+using namespace std;
+
+// solver_test [pairs] [seed]: random pairs through every path of Solver<int> and the striped kernels,
+// against brute-force references on the whole matrices. it prints the first mismatches and fails on any.
+
+static const int g_Wg = 10, g_Ws = 2;
+
+// the global alignment on full A, B and C matrices, ties broken A, B, C as in Solver<T>::Select().
+struct Reference
+{
+	int score;
+	SeqPair alignment;
+};
+
+static int Pick(int valA, int valB, int valC, int& from)
+{
+	if(valA >= valB && valA >= valC)
+	{
+		from = 1;
+		return valA;
+	}
+	if(valB >= valC)
+	{
+		from = 2;
+		return valB;
+	}
+	from = 3;
+	return valC;
+}
+
+static Reference GlobalReference(const string& seq1, const string& seq2, const BloSum62<int>& blosum62)
+{
+	const size_t m = seq1.size(), n = seq2.size();
+	vector<vector<int>> a(m + 1, vector<int>(n + 1, NEGINF)), b = a, c = a;
+	vector<vector<int>> ta(m + 1, vector<int>(n + 1, 0)), tb = ta, tc = ta;
+	a[0][0] = 0;
+	for(size_t j = 1; j <= n; ++j)
+	{
+		b[0][j] = -(g_Wg + (int)j*g_Ws);
+		tb[0][j] = (j == 1) ? 1 : 2;
+	}
+	for(size_t i = 1; i <= m; ++i)
+	{
+		c[i][0] = -(g_Wg + (int)i*g_Ws);
+		tc[i][0] = (i == 1) ? 1 : 3;
+	}
+	for(size_t i = 1; i <= m; ++i)
+	{
+		for(size_t j = 1; j <= n; ++j)
+		{
+			int sigma = blosum62.GetValue(seq1[i - 1], seq2[j - 1]);
+			a[i][j] = Pick(a[i - 1][j - 1] + sigma, b[i - 1][j - 1] + sigma, c[i - 1][j - 1] + sigma, ta[i][j]);
+			b[i][j] = Pick(a[i][j - 1] - g_Wg - g_Ws, b[i][j - 1] - g_Ws, c[i][j - 1] - g_Wg - g_Ws, tb[i][j]);
+			c[i][j] = Pick(a[i - 1][j] - g_Wg - g_Ws, b[i - 1][j] - g_Wg - g_Ws, c[i - 1][j] - g_Ws, tc[i][j]);
+		}
+	}
+
+	Reference result;
+	int state = 0;
+	result.score = Pick(a[m][n], b[m][n], c[m][n], state);
+	string& res1 = result.alignment.first;
+	string& res2 = result.alignment.second;
+	for(size_t i = m, j = n; i > 0 || j > 0; )
+	{
+		if(state == 1)
+		{
+			state = ta[i][j];
+			res1 += seq1[--i];
+			res2 += seq2[--j];
+		}
+		else if(state == 2)
+		{
+			state = tb[i][j];
+			res1 += '-';
+			res2 += seq2[--j];
+		}
+		else
+		{
+			state = tc[i][j];
+			res1 += seq1[--i];
+			res2 += '-';
+		}
+	}
+	reverse(res1.begin(), res1.end());
+	reverse(res2.begin(), res2.end());
+	return result;
+}
+
+// the best local alignment score: a pair may follow 0 instead of a path, row 0 and column 0 are -inf.
+static int LocalReference(const string& seq1, const string& seq2, const BloSum62<int>& blosum62)
+{
+	const size_t m = seq1.size(), n = seq2.size();
+	vector<vector<int>> a(m + 1, vector<int>(n + 1, NEGINF)), b = a, c = a;
+	int best = 0;
+	for(size_t i = 1; i <= m; ++i)
+	{
+		for(size_t j = 1; j <= n; ++j)
+		{
+			a[i][j] = blosum62.GetValue(seq1[i - 1], seq2[j - 1]) + max(0, max(a[i - 1][j - 1], max(b[i - 1][j - 1], c[i - 1][j - 1])));
+			b[i][j] = max(a[i][j - 1] - g_Wg - g_Ws, max(b[i][j - 1] - g_Ws, c[i][j - 1] - g_Wg - g_Ws));
+			c[i][j] = max(a[i - 1][j] - g_Wg - g_Ws, max(b[i - 1][j] - g_Wg - g_Ws, c[i - 1][j] - g_Ws));
+			best = max(best, a[i][j]);
+		}
+	}
+	return best;
+}
+
+// the score of an alignment from its columns.
+static int Rescore(const SeqPair& alignment, const BloSum62<int>& blosum62)
+{
+	int score = 0, gap = 0;
+	for(size_t k = 0; k < alignment.first.size(); ++k)
+	{
+		if(alignment.first[k] == '-')
+		{
+			score -= (gap == 1) ? g_Ws : g_Wg + g_Ws;
+			gap = 1;
+		}
+		else if(alignment.second[k] == '-')
+		{
+			score -= (gap == 2) ? g_Ws : g_Wg + g_Ws;
+			gap = 2;
+		}
+		else
+		{
+			score += blosum62.GetValue(alignment.first[k], alignment.second[k]);
+			gap = 0;
+		}
+	}
+	return score;
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t count = (argc > 1) ? std::stoull(argv[1]) : 1500;
+	std::mt19937 random((argc > 2) ? (unsigned)std::stoul(argv[2]) : 1u);
+
+	// small blocks, levels and tiles, so that short pairs go through every path.
+	Solver<int>::s_LinearBlockCells_ = 64;
+	Solver<int>::s_LinearFanout_ = 3;
+	Solver<int>::s_WavefrontCells_ = 16;
+	Solver<int>::s_TileRows_ = 5;
+	Solver<int>::s_TileCols_ = 7;
+
+	BloSum62<int> bloSum62;
+	Wavefront wavefront(4);
+	Workspace<int> workspace;
+	StripedProfile striped;
+	StripedBuffer rows;
+	const char* letters = "ARNDCQEGHILKMFPSTWYVX";
+
+	size_t failures = 0, checks = 0, stripedRuns = 0;
+	auto check = [&failures, &checks](bool ok, const char* what, size_t m, size_t n) {
+		++checks;
+		if(!ok && failures++ < 20)
+			cout << "mismatch: " << what << ", m = " << m << ", n = " << n << endl;
+	};
+
+	for(size_t pair = 0; pair < count; ++pair)
+	{
+		// empty and tiny pairs first, then related pairs, some of them unrelated or with a shared segment only.
+		const size_t limit = (pair < count/10) ? 5 : 120;
+		const size_t m = random() % (limit + 1), n = random() % (limit + 1);
+		string seq1, seq2;
+		for(size_t k = 0; k < m; ++k)
+			seq1 += letters[random() % 21];
+		if(random() % 4 == 0)
+		{
+			for(size_t k = 0; k < n; ++k)
+				seq2 += letters[random() % 21];
+		}
+		else
+		{
+			seq2 = seq1.substr(0, std::min(m, n));
+			for(char& ch : seq2)
+			{
+				if(random() % 3 == 0)
+					ch = letters[random() % 20];
+			}
+			while(seq2.size() < n)
+				seq2.insert(seq2.begin() + random() % (seq2.size() + 1), letters[random() % 20]);
+		}
+
+		const Sequence sequence1("seq1", "test", seq1), sequence2("seq2", "test", seq2);
+		const Reference reference = GlobalReference(seq1, seq2, bloSum62);
+
+		// full and linear memory, each in one sweep and in tiles on the wavefront.
+		const eMemory memories[] = { eMemory::MemoryFull, eMemory::MemoryLinear };
+		for(eMemory memory : memories)
+		{
+			for(Wavefront* tiles : { (Wavefront*)nullptr, &wavefront })
+			{
+				Solver<int> solver(sequence1, sequence2, bloSum62, memory, nullptr, Region(), tiles, &workspace);
+				const int score = solver.Update();
+				const SeqPair alignment = solver.Construct();
+				const char* what = (memory == eMemory::MemoryFull) ? ((tiles == nullptr) ? "full" : "full, tiled") : ((tiles == nullptr) ? "linear" : "linear, tiled");
+				check(score == reference.score && alignment == reference.alignment, what, m, n);
+			}
+		}
+
+		// a band and an X-drop wide enough to hold every cell are the whole rectangle.
+		{
+			Solver<int> solver(sequence1, sequence2, bloSum62, eMemory::MemoryAuto, nullptr, Region(eRegion::RegionBanded, m + n + 1), nullptr, &workspace);
+			const int score = solver.Update();
+			check(score == reference.score && solver.Construct() == reference.alignment && !solver.IsLimited(), "wide band", m, n);
+		}
+		{
+			Solver<int> solver(sequence1, sequence2, bloSum62, eMemory::MemoryAuto, nullptr, Region(eRegion::RegionXDrop, 0, 1 << 20), nullptr, &workspace);
+			const int score = solver.Update();
+			check(score == reference.score && solver.Construct() == reference.alignment && !solver.IsLimited(), "wide x-drop", m, n);
+		}
+
+		// score only: striped when the cpu has a vector unit, the scalar fill otherwise.
+		{
+			Solver<int> solver(sequence1, sequence2, bloSum62, eMemory::MemoryLinear, nullptr, Region(), nullptr, &workspace);
+			check(solver.Score() == reference.score, "score only", m, n);
+		}
+
+		// the local alignment: the scalar pass, the striped kernel, and the global alignment of its spans.
+		const int local = LocalReference(seq1, seq2, bloSum62);
+		size_t begin1 = 0, end1 = 0, begin2 = 0, end2 = 0;
+		{
+			Solver<int> solver(sequence1, sequence2, bloSum62, eMemory::MemoryAuto, nullptr, Region(), nullptr, &workspace);
+			check(solver.Locate(begin1, end1, begin2, end2) == local, "local", m, n);
+		}
+		std::vector<unsigned char> code1, code2;
+		BloSum62<int>::Encode(seq1, code1);
+		BloSum62<int>::Encode(seq2, code2);
+		striped.Assign(bloSum62.GetMatrix(), BloSum62<int>::s_Alphabet_, code2.data(), code2.size());
+		int stripedScore = 0;
+		if(StripedLocalScore(striped, code1.data(), code1.size(), g_Wg, g_Ws, rows, stripedScore))
+		{
+			++stripedRuns;
+			check(stripedScore == local, "striped local", m, n);
+		}
+		if(local > 0)
+		{
+			const Sequence span1("seq1", "test", seq1.substr(begin1, end1 - begin1)), span2("seq2", "test", seq2.substr(begin2, end2 - begin2));
+			Solver<int> solver(span1, span2, bloSum62, eMemory::MemoryLinear, nullptr, Region(), &wavefront, &workspace);
+			const int score = solver.Update();
+			const SeqPair alignment = solver.Construct();
+			const bool trimmed = alignment.first.front() != '-' && alignment.second.front() != '-' && alignment.first.back() != '-' && alignment.second.back() != '-';
+			check(score == local && Rescore(alignment, bloSum62) == local && trimmed, "local spans", m, n);
+		}
+	}
+
+	cout << "pairs: " << count << ", checks: " << checks << ", striped local runs: " << stripedRuns << " (" << StripedIsa() << "), mismatches: " << failures << endl;
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <limits>
+
+#include "striped.h"
+
+typedef enum
+{
+	IsaNone,
+	IsaSse41,
+	IsaAvx2
+} eIsa;
+
+static eIsa DetectIsa()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return eIsa::IsaAvx2;
+	if(__builtin_cpu_supports("sse4.1"))
+		return eIsa::IsaSse41;
+#endif
+	return eIsa::IsaNone;
+}
+
+static eIsa GetIsa()
+{
+	static const eIsa isa = DetectIsa();
+	return isa;
+}
+
+const char* StripedIsa()
+{
+	switch(GetIsa())
+	{
+	case eIsa::IsaAvx2:
+		return "avx2";
+	case eIsa::IsaSse41:
+		return "sse4.1";
+	default:
+		return "none";
+	}
+}
+
+// bytes of a vector of the isa.
+static size_t VectorBytes(eIsa isa)
+{
+	switch(isa)
+	{
+	case eIsa::IsaAvx2:
+		return 32;
+	case eIsa::IsaSse41:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+// the profile of query in lanes of Elem: lane l of segment s holds query position s + l*segLen,
+// positions past length are padding with score 0 and mask 0.
+template <typename Elem>
+static void Stripe(StripedBuffer& buffer, size_t vector, const int* matrix, size_t alphabet, const unsigned char* query, size_t length)
+{
+	const size_t lanes = vector/sizeof(Elem);
+	const size_t segLen = (length + lanes - 1)/lanes;
+	const int low = std::numeric_limits<Elem>::min(), high = std::numeric_limits<Elem>::max();
+	Elem* profile = (Elem*)buffer.Fit((alphabet + 1)*segLen*vector);
+	Elem* mask = profile + alphabet*segLen*lanes;
+	for(size_t s = 0; s < segLen; ++s)
+	{
+		for(size_t l = 0; l < lanes; ++l)
+		{
+			size_t q = s + l*segLen;
+			bool valid = q < length;
+			// a score out of the lanes only makes the kernel report an overflow, see StripedScore().
+			for(size_t r = 0; r < alphabet; ++r)
+				profile[(r*segLen + s)*lanes + l] = valid ? (Elem)std::min(std::max(matrix[r*alphabet + query[q]], low), high) : (Elem)0;
+			mask[s*lanes + l] = valid ? (Elem)-1 : (Elem)0;
+		}
+	}
+}
+
+void StripedProfile::Assign(const int* matrix_, size_t alphabet_, const unsigned char* query_, size_t length_)
+{
+	m_Length_ = length_;
+	m_Alphabet_ = alphabet_;
+	m_Vector_ = VectorBytes(GetIsa());
+	m_Low_ = m_High_ = 0;
+	if(m_Vector_ == 0 || length_ == 0)
+		return;
+
+	m_Low_ = *std::min_element(matrix_, matrix_ + alphabet_*alphabet_);
+	m_High_ = *std::max_element(matrix_, matrix_ + alphabet_*alphabet_);
+	Stripe<signed char>(m_Byte_, m_Vector_, matrix_, alphabet_, query_, length_);
+	Stripe<short>(m_Word_, m_Vector_, matrix_, alphabet_, query_, length_);
+}
+
+// the kernels of the cpu on the profile, 8-bit lanes first and 16-bit lanes when they overflow.
+bool StripedRun(const StripedProfile& profile, const unsigned char* seq1, size_t len1, int wg, int ws, bool local, StripedBuffer& rows, int& score)
+{
+	eIsa isa = GetIsa();
+	if(isa == eIsa::IsaNone || profile.m_Vector_ == 0 || len1 == 0 || profile.m_Length_ == 0)
+		return false;
+
+	// rows for the segments of the 16-bit lanes, the 8-bit lanes need fewer.
+	const size_t lanes = profile.m_Vector_/sizeof(short);
+	const size_t segLen = (profile.m_Length_ + lanes - 1)/lanes;
+	void* buffer = rows.Fit(3*segLen*profile.m_Vector_);
+	StripedProblem problem = { seq1, len1, profile.m_Length_, profile.m_Byte_.Get(), profile.m_Alphabet_, buffer, profile.m_Low_, profile.m_High_, wg, ws, local };
+
+	eStriped status = (isa == eIsa::IsaAvx2) ? StripedScoreAvx2Byte(problem, score) : StripedScoreSse41Byte(problem, score);
+	if(status == eStriped::Overflow)
+	{
+		problem.profile = profile.m_Word_.Get();
+		status = (isa == eIsa::IsaAvx2) ? StripedScoreAvx2Word(problem, score) : StripedScoreSse41Word(problem, score);
+	}
+
+	return status == eStriped::Done;
+}
+
+bool StripedScore(const StripedProfile& profile, const unsigned char* seq1, size_t len1, int wg, int ws, StripedBuffer& rows, int& score)
+{
+	return StripedRun(profile, seq1, len1, wg, ws, false, rows, score);
+}
+
+bool StripedLocalScore(const StripedProfile& profile, const unsigned char* seq1, size_t len1, int wg, int ws, StripedBuffer& rows, int& score)
+{
+	return StripedRun(profile, seq1, len1, wg, ws, true, rows, score);
+}
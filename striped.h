@@ -0,0 +1,107 @@
+#ifndef __STRIPED_H__
+#define __STRIPED_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// score-only affine-gap kernels in the striped layout of Farrar (2007).
+// the global recurrence is exactly the one of Solver<T>::Update(), the local one that of Solver<T>::Locate(),
+// only the matrices are never stored.
+
+typedef enum
+{
+	Done,			// the score is exact
+	Overflow,		// a lane saturated, retry with wider lanes
+	Unsupported		// no kernel for this cpu / input
+} eStriped;
+
+// bytes aligned for the widest vector unit, in a buffer that only grows.
+// copies are fine: the aligned start is found again on every call.
+class StripedBuffer
+{
+public:
+	static const size_t s_Align_ = 64;
+
+	// at least bytes_ bytes, the old contents are not kept when it grows.
+	inline void* Fit(size_t bytes_)
+	{
+		if(m_Bytes_.size() < bytes_ + s_Align_)
+			m_Bytes_.resize(bytes_ + s_Align_);
+		return Get();
+	}
+	inline void* Get()
+	{
+		return (void*)(((uintptr_t)m_Bytes_.data() + s_Align_ - 1) & ~(uintptr_t)(s_Align_ - 1));
+	}
+	inline const void* Get() const
+	{
+		return (const void*)(((uintptr_t)m_Bytes_.data() + s_Align_ - 1) & ~(uintptr_t)(s_Align_ - 1));
+	}
+
+private:
+	std::vector<unsigned char> m_Bytes_;
+};
+
+// the query side of the kernels: its substitution scores striped over the lanes of the vector unit found at runtime,
+// once in 8-bit and once in 16-bit lanes, each followed by the mask of the lanes holding a query position.
+// it is only read while scoring, so the threads scoring one query can share it.
+class StripedProfile
+{
+public:
+	StripedProfile() :
+		m_Length_(0), m_Alphabet_(0), m_Vector_(0), m_Low_(0), m_High_(0)
+	{}
+
+	// the profile of another query of length_ residue codes, against the alphabet_ x alphabet_ row-major matrix_
+	// (BloSum62<int>::GetMatrix()). the buffers keep their capacity.
+	void Assign(const int* matrix_, size_t alphabet_, const unsigned char* query_, size_t length_);
+
+	inline size_t GetLength() const
+	{
+		return m_Length_;
+	}
+
+private:
+	friend bool StripedRun(const StripedProfile&, const unsigned char*, size_t, int, int, bool, StripedBuffer&, int&);
+
+	size_t m_Length_;
+	size_t m_Alphabet_;
+	size_t m_Vector_;			// bytes of a vector, 0 without a vector unit
+	int m_Low_, m_High_;		// the smallest and the largest score of the matrix
+	StripedBuffer m_Byte_, m_Word_;
+};
+
+// one run of a kernel: the residues of seq1 against a query profile in the lanes of the kernel.
+struct StripedProblem
+{
+	const unsigned char* seq1;	// database sequence, walked row by row
+	size_t len1;
+	size_t len2;				// query length
+	const void* profile;		// alphabet rows of segments, then the lane mask, see StripedProfile
+	size_t alphabet;
+	void* rows;					// three rows of segments: two of H and one of C
+	int low, high;				// the smallest and the largest substitution score
+	int wg;						// gap open weight
+	int ws;						// gap extend weight
+	bool local;					// Smith-Waterman instead of the global alignment
+};
+
+// per-isa kernels, only valid to call when the cpu supports them.
+eStriped StripedScoreSse41Byte(const StripedProblem& problem, int& score);
+eStriped StripedScoreSse41Word(const StripedProblem& problem, int& score);
+eStriped StripedScoreAvx2Byte(const StripedProblem& problem, int& score);
+eStriped StripedScoreAvx2Word(const StripedProblem& problem, int& score);
+
+// name of the widest vector unit found at runtime: "avx2", "sse4.1" or "none".
+const char* StripedIsa();
+
+// score the encoded seq1 against the query of profile, trying saturating 8-bit lanes first and 16-bit lanes on overflow.
+// rows holds the rows of the sweep, it is kept by one thread from one pair to the next and only grows.
+// returns false when no vector unit is available or the 16-bit lanes overflow too;
+// the caller is expected to fall back to the scalar path.
+bool StripedScore(const StripedProfile& profile, const unsigned char* seq1, size_t len1, int wg, int ws, StripedBuffer& rows, int& score);
+// StripedScore() for the best local alignment (Smith-Waterman, the scores floored at 0), see Solver<T>::Locate().
+bool StripedLocalScore(const StripedProfile& profile, const unsigned char* seq1, size_t len1, int wg, int ws, StripedBuffer& rows, int& score);
+
+#endif	// __STRIPED_H__
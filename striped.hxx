@@ -0,0 +1,222 @@
+#ifndef __STRIPED_HXX__
+#define __STRIPED_HXX__
+
+// the generic striped kernel. it is included by one translation unit per instruction set,
+// each of which defines STRIPED_TARGET (a target attribute) and an Ops type before including it.
+//
+// Ops provides:
+//	Vec, Elem, s_Lanes, s_Min, s_Max
+//	Set1, Adds, Subs, Max, Min, And, AnyGt, ShiftIn (shift one lane up, the value enters lane 0)
+
+#include <immintrin.h>
+#include <algorithm>
+
+#include "common.h"
+#include "striped.h"
+
+#ifndef STRIPED_TARGET
+#error "STRIPED_TARGET must be defined before including striped.hxx"
+#endif
+
+template <typename Ops>
+STRIPED_TARGET eStriped StripedKernel(const StripedProblem& problem, int& score)
+{
+	typedef typename Ops::Vec Vec;
+	typedef typename Ops::Elem Elem;
+
+	const size_t lanes = Ops::s_Lanes;
+	const size_t len1 = problem.len1, len2 = problem.len2;
+	const size_t segLen = (len2 + lanes - 1) / lanes;
+	const int wg = problem.wg, ws = problem.ws;
+	const int go = wg + ws, ge = ws;
+
+	if(len1 == 0 || len2 == 0)
+		return eStriped::Unsupported;
+
+	// H on row 0 / column 0: max(-inf, -(Wg + k*Ws), -inf), see Solver<T>::FirstRow() and Solver<T>::FirstColumn().
+	// it is smallest at the far ends, and a clamped border can not be told from a real score.
+	auto border = [wg, ws](size_t k) -> int { return (k == 0) ? 0 : std::max(NEGINF, -(wg + (int)k*ws)); };
+	auto clamp = [](int v) -> Elem { return (Elem)std::min(std::max(v, (int)Ops::s_Min), (int)Ops::s_Max); };
+	if(border(len1) <= Ops::s_Min || border(len2) <= Ops::s_Min)
+		return eStriped::Overflow;
+	if(problem.low <= Ops::s_Min || problem.high >= Ops::s_Max)
+		return eStriped::Overflow;
+
+	// the query profile and its lane mask (StripedProfile), two H rows and the C row (the caller's rows).
+	const Vec* profile = (const Vec*)problem.profile;
+	const Vec* mask = profile + problem.alphabet*segLen;
+	Vec* hLoad = (Vec*)problem.rows;
+	Vec* hStore = hLoad + segLen;
+	Vec* mtxC = hStore + segLen;
+
+	// lane l of segment s holds query position s + l*segLen; positions past len2 are padding.
+	for(size_t s = 0; s < segLen; ++s)
+	{
+		for(size_t l = 0; l < lanes; ++l)
+		{
+			size_t q = s + l*segLen;
+			((Elem*)&hLoad[s])[l] = (q < len2) ? clamp(border(q + 1)) : (Elem)0;
+			((Elem*)&mtxC[s])[l] = clamp(NEGINF);
+		}
+	}
+
+	const Vec vGo = Ops::Set1(go), vGe = Ops::Set1(ge);
+	const Vec vLow = Ops::Set1(Ops::s_Min);
+	Vec vMin = Ops::Set1(0), vMax = Ops::Set1(0);
+
+	for(size_t i = 1; i <= len1; ++i)
+	{
+		assert(problem.seq1[i - 1] < problem.alphabet);
+		const Vec* pvProfile = profile + problem.seq1[i - 1]*segLen;
+		// A[i][j] uses H[i - 1][j - 1], which is one lane down in the last segment for segment 0.
+		Vec vHdiag = Ops::ShiftIn(hLoad[segLen - 1], clamp(border(i - 1)));
+		// B[i][1] = max(max(A, C)[i][0] - (Wg + Ws), B[i][0] - Ws), the other lanes are fixed by the lazy loop.
+		Vec vB = Ops::ShiftIn(vLow, clamp(std::max(border(i) - go, NEGINF - ge)));
+
+		for(size_t s = 0; s < segLen; ++s)
+		{
+			Vec vHprev = hLoad[s];
+			// the previous row is final here, watch it for saturation.
+			Vec vCheck = Ops::And(vHprev, mask[s]);
+			vMin = Ops::Min(vMin, vCheck);
+			vMax = Ops::Max(vMax, vCheck);
+
+			// C[i][j] = max(A[i - 1][j] - (Wg + Ws), B[i - 1][j] - (Wg + Ws), C[i - 1][j] - Ws)
+			Vec vC = Ops::Max(Ops::Subs(vHprev, vGo), Ops::Subs(mtxC[s], vGe));
+			mtxC[s] = vC;
+			// H[i][j] = max(A, B, C)[i][j]
+			Vec vH = Ops::Max(Ops::Max(Ops::Adds(vHdiag, pvProfile[s]), vC), vB);
+			hStore[s] = vH;
+			// B[i][j + 1] = max(A[i][j] - (Wg + Ws), B[i][j] - Ws, C[i][j] - (Wg + Ws))
+			vB = Ops::Max(Ops::Subs(vH, vGo), Ops::Subs(vB, vGe));
+
+			vHdiag = vHprev;
+		}
+
+		// lazy-B loop: carry B across the lane boundaries until it can not raise H any more.
+		vB = Ops::ShiftIn(vB, Ops::s_Min);
+		size_t s = 0;
+		while(Ops::AnyGt(vB, Ops::Subs(hStore[s], vGo)))
+		{
+			hStore[s] = Ops::Max(hStore[s], vB);
+			vB = Ops::Subs(vB, vGe);
+			if(++s == segLen)
+			{
+				s = 0;
+				vB = Ops::ShiftIn(vB, Ops::s_Min);
+			}
+		}
+
+		std::swap(hLoad, hStore);
+	}
+
+	// the last row.
+	for(size_t s = 0; s < segLen; ++s)
+	{
+		Vec vCheck = Ops::And(hLoad[s], mask[s]);
+		vMin = Ops::Min(vMin, vCheck);
+		vMax = Ops::Max(vMax, vCheck);
+	}
+
+	// a saturated value shows up as the lane limit in H, since A, B and C never exceed it.
+	eStriped status = eStriped::Done;
+	const Elem* pMin = (const Elem*)&vMin;
+	const Elem* pMax = (const Elem*)&vMax;
+	for(size_t l = 0; l < lanes; ++l)
+	{
+		if(pMin[l] <= Ops::s_Min || pMax[l] >= Ops::s_Max)
+			status = eStriped::Overflow;
+	}
+	if(status == eStriped::Done)
+	{
+		size_t q = len2 - 1;
+		score = ((const Elem*)&hLoad[q % segLen])[q / segLen];
+	}
+
+	return status;
+}
+
+// the local kernel: Smith-Waterman with the same gaps, H floored at 0 and the score the largest H of the rectangle
+// (see Solver<T>::Locate()). a cell below 0 never raises H, so only the upper end of the lanes can saturate.
+template <typename Ops>
+STRIPED_TARGET eStriped StripedLocalKernel(const StripedProblem& problem, int& score)
+{
+	typedef typename Ops::Vec Vec;
+	typedef typename Ops::Elem Elem;
+
+	const size_t lanes = Ops::s_Lanes;
+	const size_t len1 = problem.len1, len2 = problem.len2;
+	const size_t segLen = (len2 + lanes - 1) / lanes;
+	const int go = problem.wg + problem.ws, ge = problem.ws;
+
+	if(len1 == 0 || len2 == 0)
+		return eStriped::Unsupported;
+	// a score clamped at the lower end stays below 0 next to any H that did not saturate.
+	if(problem.high >= Ops::s_Max || go >= Ops::s_Max)
+		return eStriped::Overflow;
+
+	// the query profile (StripedProfile), two H rows and the C row (the caller's rows). H is 0 on row 0 and column 0.
+	const Vec* profile = (const Vec*)problem.profile;
+	Vec* hLoad = (Vec*)problem.rows;
+	Vec* hStore = hLoad + segLen;
+	Vec* mtxC = hStore + segLen;
+	const Vec vZero = Ops::Set1(0), vLow = Ops::Set1(Ops::s_Min);
+	for(size_t s = 0; s < segLen; ++s)
+	{
+		hLoad[s] = vZero;
+		mtxC[s] = vLow;
+	}
+
+	const Vec vGo = Ops::Set1(go), vGe = Ops::Set1(ge);
+	Vec vMax = vZero;
+
+	for(size_t i = 1; i <= len1; ++i)
+	{
+		assert(problem.seq1[i - 1] < problem.alphabet);
+		const Vec* pvProfile = profile + problem.seq1[i - 1]*segLen;
+		Vec vHdiag = Ops::ShiftIn(hLoad[segLen - 1], 0);
+		Vec vB = vLow;
+
+		for(size_t s = 0; s < segLen; ++s)
+		{
+			Vec vHprev = hLoad[s];
+			Vec vC = Ops::Max(Ops::Subs(vHprev, vGo), Ops::Subs(mtxC[s], vGe));
+			mtxC[s] = vC;
+			// H[i][j] = max(0, A, B, C)[i][j], padding lanes only repeat cells of the query.
+			Vec vH = Ops::Max(Ops::Max(Ops::Max(Ops::Adds(vHdiag, pvProfile[s]), vC), vB), vZero);
+			vMax = Ops::Max(vMax, vH);
+			hStore[s] = vH;
+			vB = Ops::Max(Ops::Subs(vH, vGo), Ops::Subs(vB, vGe));
+
+			vHdiag = vHprev;
+		}
+
+		// lazy-B loop as in StripedKernel(). B comes from an H of the row less a gap, so it never raises the max.
+		vB = Ops::ShiftIn(vB, Ops::s_Min);
+		size_t s = 0;
+		while(Ops::AnyGt(vB, Ops::Subs(hStore[s], vGo)))
+		{
+			hStore[s] = Ops::Max(hStore[s], vB);
+			vB = Ops::Subs(vB, vGe);
+			if(++s == segLen)
+			{
+				s = 0;
+				vB = Ops::ShiftIn(vB, Ops::s_Min);
+			}
+		}
+
+		std::swap(hLoad, hStore);
+	}
+
+	score = 0;
+	const Elem* pMax = (const Elem*)&vMax;
+	for(size_t l = 0; l < lanes; ++l)
+	{
+		if(pMax[l] >= Ops::s_Max)
+			return eStriped::Overflow;
+		score = std::max(score, (int)pMax[l]);
+	}
+	return eStriped::Done;
+}
+
+#endif	// __STRIPED_HXX__
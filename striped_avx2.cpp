@@ -0,0 +1,69 @@
+#include "striped.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define STRIPED_TARGET __attribute__((target("avx2")))
+#include "striped.hxx"
+
+// shifting a 256-bit register by one lane has to carry the top of the low half into the high half.
+#define AVX2_SHIFT_LANE(v, bytes) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 16 - (bytes))
+
+struct Avx2Byte
+{
+	typedef __m256i Vec;
+	typedef signed char Elem;
+	static constexpr size_t s_Lanes = 32;
+	static constexpr int s_Min = -128;
+	static constexpr int s_Max = 127;
+
+	static STRIPED_TARGET inline Vec Set1(int v) { return _mm256_set1_epi8((char)v); }
+	static STRIPED_TARGET inline Vec Adds(Vec a, Vec b) { return _mm256_adds_epi8(a, b); }
+	static STRIPED_TARGET inline Vec Subs(Vec a, Vec b) { return _mm256_subs_epi8(a, b); }
+	static STRIPED_TARGET inline Vec Max(Vec a, Vec b) { return _mm256_max_epi8(a, b); }
+	static STRIPED_TARGET inline Vec Min(Vec a, Vec b) { return _mm256_min_epi8(a, b); }
+	static STRIPED_TARGET inline Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+	static STRIPED_TARGET inline bool AnyGt(Vec a, Vec b) { return _mm256_movemask_epi8(_mm256_cmpgt_epi8(a, b)) != 0; }
+	static STRIPED_TARGET inline Vec ShiftIn(Vec v, int first) { return _mm256_insert_epi8(AVX2_SHIFT_LANE(v, 1), (char)first, 0); }
+};
+
+struct Avx2Word
+{
+	typedef __m256i Vec;
+	typedef short Elem;
+	static constexpr size_t s_Lanes = 16;
+	static constexpr int s_Min = -32768;
+	static constexpr int s_Max = 32767;
+
+	static STRIPED_TARGET inline Vec Set1(int v) { return _mm256_set1_epi16((short)v); }
+	static STRIPED_TARGET inline Vec Adds(Vec a, Vec b) { return _mm256_adds_epi16(a, b); }
+	static STRIPED_TARGET inline Vec Subs(Vec a, Vec b) { return _mm256_subs_epi16(a, b); }
+	static STRIPED_TARGET inline Vec Max(Vec a, Vec b) { return _mm256_max_epi16(a, b); }
+	static STRIPED_TARGET inline Vec Min(Vec a, Vec b) { return _mm256_min_epi16(a, b); }
+	static STRIPED_TARGET inline Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+	static STRIPED_TARGET inline bool AnyGt(Vec a, Vec b) { return _mm256_movemask_epi8(_mm256_cmpgt_epi16(a, b)) != 0; }
+	static STRIPED_TARGET inline Vec ShiftIn(Vec v, int first) { return _mm256_insert_epi16(AVX2_SHIFT_LANE(v, 2), (short)first, 0); }
+};
+
+eStriped StripedScoreAvx2Byte(const StripedProblem& problem, int& score)
+{
+	return problem.local ? StripedLocalKernel<Avx2Byte>(problem, score) : StripedKernel<Avx2Byte>(problem, score);
+}
+
+eStriped StripedScoreAvx2Word(const StripedProblem& problem, int& score)
+{
+	return problem.local ? StripedLocalKernel<Avx2Word>(problem, score) : StripedKernel<Avx2Word>(problem, score);
+}
+
+#else
+
+eStriped StripedScoreAvx2Byte(const StripedProblem&, int&)
+{
+	return eStriped::Unsupported;
+}
+
+eStriped StripedScoreAvx2Word(const StripedProblem&, int&)
+{
+	return eStriped::Unsupported;
+}
+
+#endif
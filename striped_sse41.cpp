@@ -0,0 +1,66 @@
+#include "striped.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define STRIPED_TARGET __attribute__((target("sse4.1")))
+#include "striped.hxx"
+
+struct Sse41Byte
+{
+	typedef __m128i Vec;
+	typedef signed char Elem;
+	static constexpr size_t s_Lanes = 16;
+	static constexpr int s_Min = -128;
+	static constexpr int s_Max = 127;
+
+	static STRIPED_TARGET inline Vec Set1(int v) { return _mm_set1_epi8((char)v); }
+	static STRIPED_TARGET inline Vec Adds(Vec a, Vec b) { return _mm_adds_epi8(a, b); }
+	static STRIPED_TARGET inline Vec Subs(Vec a, Vec b) { return _mm_subs_epi8(a, b); }
+	static STRIPED_TARGET inline Vec Max(Vec a, Vec b) { return _mm_max_epi8(a, b); }
+	static STRIPED_TARGET inline Vec Min(Vec a, Vec b) { return _mm_min_epi8(a, b); }
+	static STRIPED_TARGET inline Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+	static STRIPED_TARGET inline bool AnyGt(Vec a, Vec b) { return _mm_movemask_epi8(_mm_cmpgt_epi8(a, b)) != 0; }
+	static STRIPED_TARGET inline Vec ShiftIn(Vec v, int first) { return _mm_insert_epi8(_mm_slli_si128(v, 1), first, 0); }
+};
+
+struct Sse41Word
+{
+	typedef __m128i Vec;
+	typedef short Elem;
+	static constexpr size_t s_Lanes = 8;
+	static constexpr int s_Min = -32768;
+	static constexpr int s_Max = 32767;
+
+	static STRIPED_TARGET inline Vec Set1(int v) { return _mm_set1_epi16((short)v); }
+	static STRIPED_TARGET inline Vec Adds(Vec a, Vec b) { return _mm_adds_epi16(a, b); }
+	static STRIPED_TARGET inline Vec Subs(Vec a, Vec b) { return _mm_subs_epi16(a, b); }
+	static STRIPED_TARGET inline Vec Max(Vec a, Vec b) { return _mm_max_epi16(a, b); }
+	static STRIPED_TARGET inline Vec Min(Vec a, Vec b) { return _mm_min_epi16(a, b); }
+	static STRIPED_TARGET inline Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+	static STRIPED_TARGET inline bool AnyGt(Vec a, Vec b) { return _mm_movemask_epi8(_mm_cmpgt_epi16(a, b)) != 0; }
+	static STRIPED_TARGET inline Vec ShiftIn(Vec v, int first) { return _mm_insert_epi16(_mm_slli_si128(v, 2), first, 0); }
+};
+
+eStriped StripedScoreSse41Byte(const StripedProblem& problem, int& score)
+{
+	return problem.local ? StripedLocalKernel<Sse41Byte>(problem, score) : StripedKernel<Sse41Byte>(problem, score);
+}
+
+eStriped StripedScoreSse41Word(const StripedProblem& problem, int& score)
+{
+	return problem.local ? StripedLocalKernel<Sse41Word>(problem, score) : StripedKernel<Sse41Word>(problem, score);
+}
+
+#else
+
+eStriped StripedScoreSse41Byte(const StripedProblem&, int&)
+{
+	return eStriped::Unsupported;
+}
+
+eStriped StripedScoreSse41Word(const StripedProblem&, int&)
+{
+	return eStriped::Unsupported;
+}
+
+#endif
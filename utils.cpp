@@ -23,6 +23,9 @@ void GetProteinSequencePairs(const std::string& seqfile, ComparePairList& list)
 		// read the file.
 		while(std::getline(fs, line))
 		{
+			// lines written on windows keep their '\r' here.
+			if(!line.empty() && line.back() == '\r')
+				line.pop_back();
 			// analys this line.
 			if((spaceIndex = line.find(' ')) != std::string::npos)	// a new sequence.
 			{
@@ -0,0 +1,117 @@
+#include <algorithm>
+
+#include "wavefront.h"
+
+Wavefront::Wavefront(size_t threads_) :
+	m_Threads_(std::max<size_t>(threads_, 1)),
+	m_Stop_(false), m_Tile_(nullptr), m_Rows_(0), m_Cols_(0), m_Left_(0), m_Next_(0)
+{
+	for(size_t k = 1; k < m_Threads_; ++k)
+		m_Workers_.push_back(std::thread(&Wavefront::Work, this, false));
+}
+
+Wavefront::Wavefront(size_t threads_, const std::function<void()>& started_) :
+	m_Threads_(std::max<size_t>(threads_, 1)), m_Started_(started_),
+	m_Stop_(false), m_Tile_(nullptr), m_Rows_(0), m_Cols_(0), m_Left_(0), m_Next_(0)
+{}
+
+Wavefront::~Wavefront()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_Mutex_);
+		m_Stop_ = true;
+	}
+	m_Wake_.notify_all();
+	for(std::thread& worker : m_Workers_)
+		worker.join();
+}
+
+void Wavefront::Run(size_t rows_, size_t cols_, const WavefrontTile& tile_)
+{
+	std::unique_lock<std::mutex> running(m_Running_, std::try_to_lock);
+	if(!running.owns_lock() || m_Threads_ < 2)
+	{
+		// row by row keeps the order of the tiles too.
+		for(size_t r = 0; r < rows_; ++r)
+			for(size_t c = 0; c < cols_; ++c)
+				tile_(r, c);
+		return;
+	}
+	if(rows_ == 0 || cols_ == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(m_Mutex_);
+		m_Tile_ = &tile_;
+		m_Rows_ = rows_;
+		m_Cols_ = cols_;
+		m_Left_ = rows_*cols_;
+		m_Waiting_.resize(m_Left_);
+		for(size_t r = 0; r < rows_; ++r)
+			for(size_t c = 0; c < cols_; ++c)
+				m_Waiting_[r*cols_ + c] = (unsigned char)((r > 0) + (c > 0));
+		if(m_Ready_.capacity() < m_Left_)
+			m_Ready_.reserve(m_Left_);
+		m_Ready_.assign(1, 0);
+		m_Next_ = 0;
+	}
+	m_Wake_.notify_all();
+	if(m_Started_)
+		m_Started_();
+	Work(true);
+
+	std::lock_guard<std::mutex> guard(m_Mutex_);
+	m_Tile_ = nullptr;
+}
+
+bool Wavefront::IsRunning()
+{
+	std::lock_guard<std::mutex> guard(m_Mutex_);
+	return m_Tile_ != nullptr && m_Left_ > 0;
+}
+
+bool Wavefront::Help()
+{
+	if(!IsRunning())
+		return false;
+	// as the caller: until the grid is done, the tiles left of it may become ready later.
+	Work(true);
+	return true;
+}
+
+void Wavefront::Work(bool caller_)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex_);
+	while(true)
+	{
+		m_Wake_.wait(lock, [this, caller_]() { return m_Stop_ || m_Next_ < m_Ready_.size() || (caller_ && m_Left_ == 0); });
+		if(m_Next_ == m_Ready_.size())
+			return;		// the pool stops, or the grid of the caller is done.
+
+		size_t index = m_Ready_[m_Next_++];
+		const WavefrontTile& tile = *m_Tile_;
+		const size_t cols = m_Cols_, r = index/cols, c = index%cols;
+		lock.unlock();
+		tile(r, c);
+		lock.lock();
+
+		// the tiles below and right of it may be ready now.
+		size_t ready = 0;
+		if(r + 1 < m_Rows_ && --m_Waiting_[index + cols] == 0)
+		{
+			m_Ready_.push_back(index + cols);
+			++ready;
+		}
+		if(c + 1 < cols && --m_Waiting_[index + 1] == 0)
+		{
+			m_Ready_.push_back(index + 1);
+			++ready;
+		}
+		if(--m_Left_ == 0)
+			m_Wake_.notify_all();
+		else if(ready > 1)
+			m_Wake_.notify_all();
+		else if(ready == 1)
+			m_Wake_.notify_one();
+	}
+}
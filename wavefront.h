@@ -0,0 +1,61 @@
+#ifndef __WAVEFRONT_H__
+#define __WAVEFRONT_H__
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "common.h"
+
+// a tile of a grid, by row and column.
+typedef std::function<void(size_t, size_t)> WavefrontTile;
+
+// a pool of threads for the tiles of one dp rectangle.
+// a tile may start once the tile above and the tile left of it are done, so the tiles run along anti-diagonals
+// and only the cells on the edges of a tile are shared with the next ones.
+class Wavefront
+{
+public:
+	// threads_ - 1 threads are started, the thread calling Run() is the last one.
+	explicit Wavefront(size_t threads_);
+	// no threads are started: up to threads_ - 1 threads of the owner take tiles through Help() when they are idle.
+	// started_ is called on the thread of Run() when a grid starts, without a lock of the pool, to wake them.
+	Wavefront(size_t threads_, const std::function<void()>& started_);
+	~Wavefront();
+
+	inline size_t GetThreads() const
+	{
+		return m_Threads_;
+	}
+
+	// calls tile_(r, c) for every tile of a rows_ x cols_ grid and returns when all are done.
+	// one grid runs at a time, a caller finding the pool busy runs its grid on its own thread, row by row.
+	void Run(size_t rows_, size_t cols_, const WavefrontTile& tile_);
+
+	// whether a grid has tiles left, and taking them until it is done. Help() returns false if there was no grid.
+	bool IsRunning();
+	bool Help();
+
+private:
+	// takes ready tiles until the pool stops, or with caller_ until the grid is done.
+	void Work(bool caller_);
+
+private:
+	size_t m_Threads_;
+	std::function<void()> m_Started_;
+	std::vector<std::thread> m_Workers_;
+	std::mutex m_Running_;		// held by the caller of the running grid
+
+	// guarded by m_Mutex_.
+	std::mutex m_Mutex_;
+	std::condition_variable m_Wake_;
+	bool m_Stop_;
+	const WavefrontTile* m_Tile_;
+	size_t m_Rows_, m_Cols_, m_Left_;
+	std::vector<unsigned char> m_Waiting_;	// per tile: 0, 1 or 2 of the tiles above and left not done yet
+	std::vector<size_t> m_Ready_;			// first in, first out from m_Next_: the ready tiles stay in anti-diagonal order
+	size_t m_Next_;							// every tile is queued once a grid, so the vector only grows to rows x cols
+};
+
+#endif	// __WAVEFRONT_H__